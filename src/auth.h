@@ -3,6 +3,7 @@
 
 #include <string>
 #include "../vendor/liboauthcpp/include/liboauthcpp/liboauthcpp.h"
+#include "signer.h"
 
 namespace twitter {
 
@@ -16,7 +17,12 @@ namespace twitter {
       std::string accessSecret) :
         consumer_(std::move(consumerKey), std::move(consumerSecret)),
         token_(std::move(accessKey), std::move(accessSecret)),
-        client_(&consumer_, &token_)
+        client_(&consumer_, &token_),
+        signer_(
+          consumer_.key(),
+          consumer_.secret(),
+          token_.key(),
+          token_.secret())
     {
     }
 
@@ -25,11 +31,17 @@ namespace twitter {
       return client_;
     }
 
+    const signer& getSigner() const
+    {
+      return signer_;
+    }
+
   private:
 
     OAuth::Consumer consumer_;
     OAuth::Token token_;
     OAuth::Client client_;
+    signer signer_;
   };
 
 };
@@ -0,0 +1,86 @@
+#include "checkpoint_store.h"
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include "codes.h"
+#include "util.h"
+
+namespace twitter {
+
+  checkpoint_store::checkpoint_store(std::string path) :
+    path_(std::move(path))
+  {
+    std::string data;
+    if (!readFile(path_, data))
+    {
+      return;
+    }
+
+    std::istringstream lines(data);
+    std::string line;
+
+    while (std::getline(lines, line))
+    {
+      if (line.empty())
+      {
+        continue;
+      }
+
+      std::istringstream fields(line);
+      std::string key;
+      tweet_id id;
+
+      if (!(fields >> key >> id) || !(fields >> std::ws).eof())
+      {
+        throw storage_error("Checkpoint file " + path_ + " is damaged");
+      }
+
+      checkpoints_[key] = id;
+    }
+  }
+
+  bool checkpoint_store::load(const std::string& key, tweet_id& id) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = checkpoints_.find(key);
+    if (it == std::end(checkpoints_))
+    {
+      return false;
+    }
+
+    id = it->second;
+
+    return true;
+  }
+
+  void checkpoint_store::save(const std::string& key, tweet_id id)
+  {
+    // Such a key would be read back as a different one, or break the line.
+    if (key.empty() ||
+      std::any_of(std::begin(key), std::end(key), [] (unsigned char c) {
+        return std::isspace(c);
+      }))
+    {
+      throw std::invalid_argument("checkpoint key is empty or has whitespace");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::map<std::string, tweet_id> updated = checkpoints_;
+    updated[key] = id;
+
+    std::ostringstream data;
+
+    for (const auto& checkpoint : updated)
+    {
+      data << checkpoint.first << " " << checkpoint.second << "\n";
+    }
+
+    writeFileAtomically(path_, data.str());
+
+    checkpoints_ = std::move(updated);
+  }
+
+}
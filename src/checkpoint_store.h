@@ -0,0 +1,43 @@
+#ifndef CHECKPOINT_STORE_H_58A2D3F6
+#define CHECKPOINT_STORE_H_58A2D3F6
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "tweet.h"
+
+namespace twitter {
+
+  // Remembers the newest tweet id seen on each of a set of timelines in a
+  // file, so that a restarted process can carry on where it left off. The
+  // file is a line of text per timeline and is rewritten atomically on each
+  // save.
+  class checkpoint_store {
+  public:
+
+    // Loads the file if it exists. Throws storage_error if it can't be read
+    // or is damaged.
+    explicit checkpoint_store(std::string path);
+
+    checkpoint_store(const checkpoint_store& other) = delete;
+    checkpoint_store& operator=(const checkpoint_store& other) = delete;
+
+    // Returns false if nothing has been saved under the key.
+    bool load(const std::string& key, tweet_id& id) const;
+
+    // Throws std::invalid_argument if the key is empty or contains
+    // whitespace, and storage_error if the file can't be written, in which
+    // case the previous checkpoint is kept.
+    void save(const std::string& key, tweet_id id);
+
+  private:
+
+    std::string path_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, tweet_id> checkpoints_;
+  };
+
+}
+
+#endif /* end of include guard: CHECKPOINT_STORE_H_58A2D3F6 */
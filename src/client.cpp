@@ -4,19 +4,326 @@
 #include <algorithm>
 #include <json.hpp>
 #include <thread>
+#include <system_error>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <hkutil/string.h>
 #include "request.h"
+#include "decoder.h"
+#include "user_table.h"
+#include "util.h"
 
 namespace twitter {
 
+  // Replaced configurations kept alive for getConfiguration; a week's worth.
+  static const size_t keptConfigurations = 7;
+
+  static void cacheConfiguration(const std::string& path, const std::string& data)
+  {
+    try
+    {
+      writeFileAtomically(path, data);
+    } catch (const storage_error& error)
+    {
+      // The cache only saves time at startup, so this is not worth failing
+      // over.
+    }
+  }
+
+  static void requireOffLoop(const engine& async, const char* call)
+  {
+    if (async.onLoopThread())
+    {
+      throw std::logic_error(
+        std::string(call) + " would wait on the engine from its own thread");
+    }
+  }
+
+  template <typename Object>
+  static Object decodeObject(const std::string& data)
+  {
+    decoder input(data);
+
+    return Object(input);
+  }
+
+  // Passes each id on one page of a cursored id list to insert and returns
+  // the cursor for the next page.
+  template <typename Insert>
+  static long long decodeIdsPage(
+    const std::string& data,
+    Insert insert)
+  {
+    long long next_cursor = 0;
+    bool hasCursor = false;
+
+    decoder input(data);
+    input.beginObject();
+
+    std::string key;
+    while (input.nextKey(key))
+    {
+      if (key == "ids")
+      {
+        input.beginArray();
+
+        while (input.nextElement())
+        {
+          insert(input.readUnsigned());
+        }
+      } else if (key == "next_cursor")
+      {
+        next_cursor = input.readInteger();
+        hasCursor = true;
+      } else {
+        input.skipValue();
+      }
+    }
+
+    input.finish();
+
+    if (!hasCursor)
+    {
+      throw std::domain_error("next_cursor is missing");
+    }
+
+    return next_cursor;
+  }
+
+  // Reads just the cursor from a page of ids by looking for it from the end
+  // of the page, where Twitter puts it. Only the cursors and numbers can
+  // appear in the page, so the key can't turn up inside a string. Returns
+  // false if it isn't there.
+  static bool scanNextCursor(const std::string& data, long long& cursor)
+  {
+    static const std::string key = "\"next_cursor\"";
+
+    std::string::size_type at = data.rfind(key);
+    if (at == std::string::npos)
+    {
+      return false;
+    }
+
+    const char* cur = data.data() + at + key.size();
+    const char* end = data.data() + data.size();
+
+    while ((cur != end) &&
+      ((*cur == ' ') || (*cur == '\n') || (*cur == '\r') || (*cur == '\t')))
+    {
+      cur++;
+    }
+
+    if ((cur == end) || (*cur != ':'))
+    {
+      return false;
+    }
+
+    decoder input(cur + 1, end);
+    cursor = input.readInteger();
+
+    return true;
+  }
+
   client::client(
     const auth& _arg) :
+      client(_arg, std::make_shared<connection_pool>())
+  {
+  }
+
+  client::client(
+    const auth& _arg,
+    std::shared_ptr<connection_pool> pool) :
+      client(_arg, std::move(pool), std::make_shared<engine>())
+  {
+  }
+
+  // Counts the client's transfers and running timer tasks, so that the
+  // destructor can wait for them. Timer tasks that haven't started when the
+  // client closes are dropped.
+  struct client::lifeline {
+    std::mutex mutex;
+    std::condition_variable idle;
+    bool closing = false;
+    size_t active = 0;
+
+    void release()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      active--;
+      idle.notify_all();
+    }
+  };
+
+  client::client(
+    const auth& _arg,
+    std::shared_ptr<connection_pool> pool,
+    std::shared_ptr<engine> async,
+    verification mode) :
       auth_(_arg),
-      currentUser_(
-        get(auth_,
-          "https://api.twitter.com/1.1/account/verify_credentials.json")
-            .perform())
+      pool_(std::move(pool)),
+      engine_(std::move(async)),
+      lifeline_(std::make_shared<lifeline>()),
+      users_(std::make_shared<user_table>()),
+      limiter_(std::make_shared<rate_limiter>()),
+      verification_(mode)
+  {
+    const std::string url =
+      "https://api.twitter.com/1.1/account/verify_credentials.json";
+
+    if (mode == verification::background)
+    {
+      auto verified = std::make_shared<std::promise<user>>();
+      currentUser_ = verified->get_future().share();
+
+      verifyAsync(url, verified, 1, retry_policy::clock::now());
+    } else {
+      currentUser_ = std::async(std::launch::deferred,
+        [this, url] () {
+          return decodeObject<user>(
+            get(auth_, url, pool_.get(), limiter_.get()).perform());
+        }).share();
+
+      if (mode == verification::immediate)
+      {
+        currentUser_.get();
+      }
+    }
+  }
+
+  client::~client()
   {
+    // A background verification may still be retrying on the engine.
+    if (verification_ == verification::background)
+    {
+      currentUser_.wait();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(refreshMutex_);
+
+      refreshDone_.wait(lock, [this] () {
+        return !refreshing_;
+      });
+    }
+
+    std::unique_lock<std::mutex> lock(lifeline_->mutex);
+
+    lifeline_->closing = true;
+    lifeline_->idle.wait(lock, [this] () {
+      return lifeline_->active == 0;
+    });
+  }
+
+  void client::submit(
+    std::unique_ptr<request> req,
+    engine::success_callback success,
+    engine::failure_callback failure) const
+  {
+    std::shared_ptr<lifeline> life = lifeline_;
+
+    {
+      std::unique_lock<std::mutex> lock(life->mutex);
+
+      if (life->closing)
+      {
+        lock.unlock();
+        failure(std::make_exception_ptr(connection_error()));
+
+        return;
+      }
+
+      life->active++;
+    }
+
+    // A call whose window is known to be used up waits on a timer the
+    // client can drop, rather than inside the engine where the destructor
+    // would have to wait for the window to reset.
+    rate_limiter::window window;
+    if ((limiter_->getPolicy() == rate_policy::block)
+      && limiter_->getWindow(rate_limiter::endpointOf(req->getUrl()), window)
+      && (window.remaining <= 0)
+      && (window.reset > rate_limiter::clock::now()))
+    {
+      auto deferred = std::make_shared<std::unique_ptr<request>>(std::move(req));
+
+      schedule(
+        std::chrono::steady_clock::now() +
+          (window.reset - rate_limiter::clock::now()),
+        [=] () {
+          submit(std::move(*deferred), success, failure);
+        });
+
+      life->release();
+
+      return;
+    }
+
+    // The failure callback is called here rather than by the engine when
+    // the success callback throws, so that the transfer is released once.
+    engine_->submit(
+      std::move(req),
+      [life, success, failure] (std::string response) {
+        try
+        {
+          success(std::move(response));
+        } catch (...)
+        {
+          try
+          {
+            failure(std::current_exception());
+          } catch (...)
+          {
+          }
+        }
+
+        life->release();
+      },
+      [life, failure] (std::exception_ptr error) {
+        try
+        {
+          failure(error);
+        } catch (...)
+        {
+        }
+
+        life->release();
+      });
+  }
+
+  void client::schedule(
+    std::chrono::steady_clock::time_point when,
+    std::function<void()> task) const
+  {
+    std::shared_ptr<lifeline> life = lifeline_;
+
+    engine_->schedule(when, [life, task] () {
+      {
+        std::lock_guard<std::mutex> lock(life->mutex);
+
+        if (life->closing)
+        {
+          return;
+        }
+
+        life->active++;
+      }
+
+      try
+      {
+        task();
+      } catch (...)
+      {
+      }
+
+      life->release();
+    });
   }
 
   tweet client::updateStatus(std::string msg, std::list<long> media_ids) const
@@ -30,13 +337,44 @@ namespace twitter {
       datastrstream << hatkirby::implode(std::begin(media_ids), std::end(media_ids), ",");
     }
 
-    return tweet(
+    return decodeObject<tweet>(
       post(auth_,
         "https://api.twitter.com/1.1/statuses/update.json",
-        datastrstream.str())
+        datastrstream.str(),
+        pool_.get(),
+        limiter_.get())
       .perform());
   }
 
+  std::future<tweet> client::updateStatusAsync(std::string msg, std::list<long> media_ids) const
+  {
+    std::stringstream datastrstream;
+    datastrstream << "status=" << OAuth::PercentEncode(msg);
+
+    if (!media_ids.empty())
+    {
+      datastrstream << "&media_ids=";
+      datastrstream << hatkirby::implode(std::begin(media_ids), std::end(media_ids), ",");
+    }
+
+    auto promise = std::make_shared<std::promise<tweet>>();
+
+    submit(
+      std::make_unique<post>(auth_,
+        "https://api.twitter.com/1.1/statuses/update.json",
+        datastrstream.str(),
+        pool_.get(),
+        limiter_.get()),
+      [promise] (std::string response) {
+        promise->set_value(decodeObject<tweet>(response));
+      },
+      [promise] (std::exception_ptr error) {
+        promise->set_exception(error);
+      });
+
+    return promise->get_future();
+  }
+
   tweet client::replyToTweet(std::string msg, tweet_id in_response_to, std::list<long> media_ids) const
   {
     std::stringstream datastrstream;
@@ -50,10 +388,12 @@ namespace twitter {
       datastrstream << hatkirby::implode(std::begin(media_ids), std::end(media_ids), ",");
     }
 
-    return tweet(
+    return decodeObject<tweet>(
       post(auth_,
         "https://api.twitter.com/1.1/statuses/update.json",
-        datastrstream.str())
+        datastrstream.str(),
+        pool_.get(),
+        limiter_.get())
       .perform());
   }
 
@@ -62,10 +402,183 @@ namespace twitter {
     return replyToTweet(msg, in_response_to.getID(), media_ids);
   }
 
-  long client::uploadMedia(std::string media_type, const char* data, long data_length) const try
+  struct client::media_segment {
+    std::string buffer;
+    curl_httppost* form = nullptr;
+
+    ~media_segment()
+    {
+      curl_formfree(form);
+    }
+  };
+
+  struct client::media_upload {
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t in_flight = 0;
+    std::exception_ptr error;
+  };
+
+  long client::uploadMedia(std::string media_type, const char* data, long data_length) const
+  {
+    return uploadMediaAsync(std::move(media_type), data, data_length).get();
+  }
+
+  long client::uploadMedia(
+    std::string media_type,
+    media_reader reader,
+    long total_length) const
+  {
+    return uploadMediaAsync(
+      std::move(media_type),
+      std::move(reader),
+      total_length).get();
+  }
+
+  long client::uploadMediaFile(std::string media_type, const std::string& path) const
+  {
+    return uploadMediaFileAsync(std::move(media_type), path).get();
+  }
+
+  std::future<long> client::uploadMediaAsync(
+    std::string media_type,
+    const char* data,
+    long data_length) const
+  {
+    return uploadSegmented(media_type, data_length,
+      [data] (std::string&, size_t offset, size_t) {
+        return data + offset;
+      });
+  }
+
+  std::future<long> client::uploadMediaAsync(
+    std::string media_type,
+    media_reader reader,
+    long total_length) const
+  {
+    return uploadSegmented(media_type, total_length,
+      [&reader] (std::string& buffer, size_t, size_t length) {
+        buffer.resize(length);
+
+        for (size_t filled = 0; filled < length;)
+        {
+          size_t read = reader(&buffer[filled], length - filled);
+
+          if (read == 0)
+          {
+            throw std::invalid_argument("Media ended before total_length bytes");
+          }
+
+          filled += read;
+        }
+
+        return buffer.data();
+      });
+  }
+
+  std::future<long> client::uploadMediaFileAsync(
+    std::string media_type,
+    const std::string& path) const
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      throw storage_error("Could not open media file " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+      close(fd);
+
+      throw storage_error("Could not read media file " + path);
+    }
+
+    size_t length = info.st_size;
+    void* mapped = nullptr;
+
+    if (length > 0)
+    {
+      mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+      throw storage_error("Could not map media file " + path);
+    }
+
+    if (mapped)
+    {
+      madvise(mapped, length, MADV_SEQUENTIAL);
+    }
+
+    // Every byte has been sent by the time this returns, so the mapping is
+    // not needed while the media is processed.
+    try
+    {
+      std::future<long> result = uploadMediaAsync(
+        std::move(media_type),
+        static_cast<const char*>(mapped),
+        length);
+
+      if (mapped)
+      {
+        munmap(mapped, length);
+      }
+
+      return result;
+    } catch (...)
+    {
+      if (mapped)
+      {
+        munmap(mapped, length);
+      }
+
+      throw;
+    }
+  }
+
+  template <typename Source>
+  std::future<long> client::uploadSegmented(
+    const std::string& media_type,
+    long total_length,
+    Source source) const try
+  {
+    // Segments are waited for on the calling thread, even by the Async
+    // variants.
+    requireOffLoop(*engine_, "uploadMedia");
+
+    if (total_length <= 0)
+    {
+      throw std::invalid_argument("Media must be at least one byte long");
+    }
+
+    long media_id = initMedia(media_type, total_length);
+
+    appendMedia(media_id, total_length, std::move(source));
+
+    auto promise = std::make_shared<std::promise<long>>();
+    std::future<long> result = promise->get_future();
+
+    if (finalizeMedia(media_id))
+    {
+      pollMediaStatus(media_id, promise, 1, retry_policy::clock::now());
+    } else {
+      promise->set_value(media_id);
+    }
+
+    return result;
+  } catch (const curl::curl_exception& error)
+  {
+    std::throw_with_nested(connection_error());
+  }
+
+  long client::initMedia(const std::string& media_type, long total_length) const
   {
     curl::curl_form form;
-    std::string str_data_length = std::to_string(data_length);
+    std::string str_data_length = std::to_string(total_length);
 
     curl::curl_pair<CURLformoption, std::string> command_name(CURLFORM_COPYNAME, "command");
     curl::curl_pair<CURLformoption, std::string> command_cont(CURLFORM_COPYCONTENTS, "INIT");
@@ -87,7 +600,9 @@ namespace twitter {
     std::string init_response =
       multipost(auth_,
         "https://upload.twitter.com/1.1/media/upload.json",
-        form.get())
+        form.get(),
+        pool_.get(),
+        limiter_.get())
       .perform();
 
     long media_id;
@@ -104,22 +619,139 @@ namespace twitter {
       std::throw_with_nested(invalid_response(init_response));
     }
 
-    // TODO: Currently have to use the C libcurl API to create this form because it uses a buffer and
-    // libcurlcpp currently messes that up.
-    curl_httppost* append_form_post = nullptr;
-    curl_httppost* append_form_last = nullptr;
-    if ( curl_formadd(&append_form_post, &append_form_last, CURLFORM_COPYNAME, "command", CURLFORM_COPYCONTENTS, "APPEND", CURLFORM_END)
-      || curl_formadd(&append_form_post, &append_form_last, CURLFORM_COPYNAME, "media_id", CURLFORM_COPYCONTENTS, std::to_string(media_id).c_str(), CURLFORM_END)
-      || curl_formadd(&append_form_post, &append_form_last, CURLFORM_COPYNAME, "media", CURLFORM_BUFFER, "media", CURLFORM_BUFFERPTR, data, CURLFORM_BUFFERLENGTH, data_length, CURLFORM_CONTENTTYPE, "application/octet-stream", CURLFORM_END)
-      || curl_formadd(&append_form_post, &append_form_last, CURLFORM_COPYNAME, "segment_index", CURLFORM_COPYCONTENTS, std::to_string(0).c_str(), CURLFORM_END))
+    return media_id;
+  }
+
+  template <typename Source>
+  void client::appendMedia(long media_id, long total_length, Source source) const
+  {
+    auto upload = std::make_shared<media_upload>();
+    std::string str_media_id = std::to_string(media_id);
+    size_t total = total_length;
+    size_t segmentSize = std::max<size_t>(mediaSegmentSize_, 1);
+    size_t concurrency = std::max<size_t>(mediaConcurrency_, 1);
+
+    for (size_t offset = 0, index = 0; offset < total; offset += segmentSize, index++)
     {
-      assert(false);
+      std::unique_lock<std::mutex> lock(upload->mutex);
+
+      upload->changed.wait(lock, [&] () {
+        return (upload->in_flight < concurrency) || upload->error;
+      });
+
+      if (upload->error)
+      {
+        break;
+      }
+
+      lock.unlock();
+
+      size_t length = std::min(segmentSize, total - offset);
+      auto segment = std::make_shared<media_segment>();
+
+      const char* data;
+
+      try
+      {
+        data = source(segment->buffer, offset, length);
+      } catch (...)
+      {
+        lock.lock();
+
+        upload->error = std::current_exception();
+
+        break;
+      }
+
+      // The segment is attached as a buffer, which curlcpp's forms can't
+      // hold, so this form is built with the C API.
+      curl_httppost* append_form_last = nullptr;
+      if ( curl_formadd(&segment->form, &append_form_last, CURLFORM_COPYNAME, "command", CURLFORM_COPYCONTENTS, "APPEND", CURLFORM_END)
+        || curl_formadd(&segment->form, &append_form_last, CURLFORM_COPYNAME, "media_id", CURLFORM_COPYCONTENTS, str_media_id.c_str(), CURLFORM_END)
+        || curl_formadd(&segment->form, &append_form_last, CURLFORM_COPYNAME, "media", CURLFORM_BUFFER, "media", CURLFORM_BUFFERPTR, data, CURLFORM_BUFFERLENGTH, static_cast<long>(length), CURLFORM_CONTENTTYPE, "application/octet-stream", CURLFORM_END)
+        || curl_formadd(&segment->form, &append_form_last, CURLFORM_COPYNAME, "segment_index", CURLFORM_COPYCONTENTS, std::to_string(index).c_str(), CURLFORM_END))
+      {
+        assert(false);
+      }
+
+      lock.lock();
+      upload->in_flight++;
+      lock.unlock();
+
+      submitMediaSegment(upload, segment, 1, retry_policy::clock::now());
     }
 
-    multipost(auth_, "https://upload.twitter.com/1.1/media/upload.json", append_form_post).perform();
+    std::unique_lock<std::mutex> lock(upload->mutex);
+
+    upload->changed.wait(lock, [&] () {
+      return upload->in_flight == 0;
+    });
+
+    if (upload->error)
+    {
+      std::rethrow_exception(upload->error);
+    }
+  }
+
+  void client::submitMediaSegment(
+    std::shared_ptr<media_upload> upload,
+    std::shared_ptr<media_segment> segment,
+    size_t attempt,
+    retry_policy::clock::time_point start) const
+  {
+    auto settle = [upload] (std::exception_ptr error) {
+      std::lock_guard<std::mutex> lock(upload->mutex);
+
+      if (error && !upload->error)
+      {
+        upload->error = error;
+      }
+
+      upload->in_flight--;
+      upload->changed.notify_all();
+    };
+
+    std::unique_ptr<request> req;
+
+    try
+    {
+      req = std::make_unique<multipost>(auth_,
+        "https://upload.twitter.com/1.1/media/upload.json",
+        segment->form,
+        pool_.get(),
+        limiter_.get());
+    } catch (...)
+    {
+      settle(std::current_exception());
+
+      return;
+    }
 
-    curl_formfree(append_form_post);
+    // Each segment is sent with its index, so sending one again after a
+    // failure is harmless.
+    submit(
+      std::move(req),
+      [settle, segment] (std::string) {
+        settle(nullptr);
+      },
+      [=] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
+
+        if (retry_.shouldRetry(error, attempt, start, delay))
+        {
+          schedule(
+            retry_policy::clock::now() + delay,
+            [=] () {
+              submitMediaSegment(upload, segment, attempt + 1, start);
+            });
+        } else {
+          settle(error);
+        }
+      });
+  }
 
+  bool client::finalizeMedia(long media_id) const
+  {
     curl::curl_form finalize_form;
     std::string str_media_id = std::to_string(media_id);
 
@@ -133,7 +765,9 @@ namespace twitter {
     std::string finalize_response =
       multipost(auth_,
         "https://upload.twitter.com/1.1/media/upload.json",
-        finalize_form.get())
+        finalize_form.get(),
+        pool_.get(),
+        limiter_.get())
       .perform();
 
     nlohmann::json finalize_json;
@@ -146,14 +780,35 @@ namespace twitter {
       std::throw_with_nested(invalid_response(finalize_response));
     }
 
-    if (finalize_json.find("processing_info") != finalize_json.end())
+    return finalize_json.find("processing_info") != finalize_json.end();
+  }
+
+  void client::pollMediaStatus(
+    long media_id,
+    std::shared_ptr<std::promise<long>> promise,
+    size_t attempt,
+    retry_policy::clock::time_point start) const
+  {
+    std::unique_ptr<request> req;
+
+    try
     {
-      std::stringstream datastr;
-      datastr << "https://upload.twitter.com/1.1/media/upload.json?command=STATUS&media_id=" << media_id;
+      req = std::make_unique<get>(auth_,
+        "https://upload.twitter.com/1.1/media/upload.json?command=STATUS&media_id=" +
+          std::to_string(media_id),
+        pool_.get(),
+        limiter_.get());
+    } catch (...)
+    {
+      promise->set_exception(std::current_exception());
 
-      for (;;)
-      {
-        std::string status_response = get(auth_, datastr.str()).perform();
+      return;
+    }
+
+    submit(
+      std::move(req),
+      [=] (std::string status_response) {
+        int ttw;
 
         try
         {
@@ -162,11 +817,15 @@ namespace twitter {
 
           if (state == "succeeded")
           {
-            break;
+            promise->set_value(media_id);
+
+            return;
+          } else if (state == "failed")
+          {
+            throw invalid_media("Twitter could not process the media");
           }
 
-          int ttw = status_json["processing_info"]["check_after_secs"].get<int>();
-          std::this_thread::sleep_for(std::chrono::seconds(ttw));
+          ttw = status_json["processing_info"]["check_after_secs"].get<int>();
         } catch (const std::invalid_argument& error)
         {
           std::throw_with_nested(invalid_response(status_response));
@@ -174,37 +833,258 @@ namespace twitter {
         {
           std::throw_with_nested(invalid_response(status_response));
         }
-      }
-    }
 
-    return media_id;
-  } catch (const curl::curl_exception& error)
-  {
-    std::throw_with_nested(connection_error());
+        schedule(
+          std::chrono::steady_clock::now() + std::chrono::seconds(ttw),
+          [=] () {
+            pollMediaStatus(media_id, promise, 1, retry_policy::clock::now());
+          });
+      },
+      [=] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
+
+        if (retry_.shouldRetry(error, attempt, start, delay))
+        {
+          schedule(
+            retry_policy::clock::now() + delay,
+            [=] () {
+              pollMediaStatus(media_id, promise, attempt + 1, start);
+            });
+        } else {
+          promise->set_exception(error);
+        }
+      });
   }
 
   std::set<user_id> client::getFriends(user_id id) const
   {
-    long long cursor = -1;
-    std::set<user_id> result;
+    std::set<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/friends/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return result;
+  }
+
+  std::set<user_id> client::getFriends(const user& id) const
+  {
+    return getFriends(id.getID());
+  }
+
+  std::set<user_id> client::getFriends() const
+  {
+    return getFriends(getUser().getID());
+  }
+
+  std::set<user_id> client::getFollowers(user_id id) const
+  {
+    std::set<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/followers/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return result;
+  }
+
+  std::set<user_id> client::getFollowers(const user& id) const
+  {
+    return getFollowers(id.getID());
+  }
+
+  std::set<user_id> client::getFollowers() const
+  {
+    return getFollowers(getUser().getID());
+  }
+
+  std::set<user_id> client::getBlocks() const
+  {
+    std::set<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/blocks/ids.json?cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return result;
+  }
+
+  id_set client::getFriendIds(user_id id) const
+  {
+    std::vector<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/friends/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::end(result), std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return id_set(std::move(result));
+  }
+
+  id_set client::getFriendIds(const user& id) const
+  {
+    return getFriendIds(id.getID());
+  }
+
+  id_set client::getFriendIds() const
+  {
+    return getFriendIds(getUser().getID());
+  }
+
+  id_set client::getFollowerIds(user_id id) const
+  {
+    std::vector<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/followers/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::end(result), std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return id_set(std::move(result));
+  }
+
+  id_set client::getFollowerIds(const user& id) const
+  {
+    return getFollowerIds(id.getID());
+  }
+
+  id_set client::getFollowerIds() const
+  {
+    return getFollowerIds(getUser().getID());
+  }
+
+  id_set client::getBlockIds() const
+  {
+    std::vector<user_id> result;
+
+    walkIds(
+      "https://api.twitter.com/1.1/blocks/ids.json?cursor=",
+      -1,
+      [&] (const std::vector<user_id>& page, long long) {
+        result.insert(std::end(result), std::begin(page), std::end(page));
+
+        return true;
+      },
+      true);
+
+    return id_set(std::move(result));
+  }
+
+  long long client::walkFriends(
+    user_id id,
+    const id_page_callback& callback,
+    long long cursor) const
+  {
+    return walkIds(
+      "https://api.twitter.com/1.1/friends/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      cursor,
+      callback);
+  }
+
+  long long client::walkFollowers(
+    user_id id,
+    const id_page_callback& callback,
+    long long cursor) const
+  {
+    return walkIds(
+      "https://api.twitter.com/1.1/followers/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      cursor,
+      callback);
+  }
+
+  long long client::walkBlocks(
+    const id_page_callback& callback,
+    long long cursor) const
+  {
+    return walkIds(
+      "https://api.twitter.com/1.1/blocks/ids.json?cursor=",
+      cursor,
+      callback);
+  }
+
+  long long client::walkIds(
+    std::string url,
+    long long cursor,
+    const id_page_callback& callback,
+    bool prefetch) const
+  {
+    std::vector<user_id> page;
+    std::future<std::string> pending;
+
+    // Waiting for a prefetched page on the engine's own thread would
+    // deadlock, so there the pages are fetched one after another.
+    prefetch = prefetch && !engine_->onLoopThread();
 
     while (cursor != 0)
     {
-      std::stringstream urlstream;
-      urlstream << "https://api.twitter.com/1.1/friends/ids.json?user_id=";
-      urlstream << id;
-      urlstream << "&cursor=";
-      urlstream << cursor;
+      std::string response_data;
+
+      if (pending.valid())
+      {
+        response_data = pending.get();
+      } else {
+        std::string pageUrl = url + std::to_string(cursor);
 
-      std::string url = urlstream.str();
-      std::string response_data = get(auth_, url).perform();
+        response_data = retry_.run([&] () {
+          return get(auth_, pageUrl, pool_.get(), limiter_.get()).perform();
+        });
+      }
+
+      long long next_cursor;
+      page.clear();
 
       try
       {
-        nlohmann::json rjs = nlohmann::json::parse(response_data);
+        // Ask for the next page before decoding this one, so that the
+        // decoding happens while the next page is on its way.
+        long long scanned;
+        if (prefetch && scanNextCursor(response_data, scanned) && (scanned != 0))
+        {
+          pending = fetchAsync(url + std::to_string(scanned));
+        }
 
-        cursor = rjs["next_cursor"].get<long long>();
-        result.insert(std::begin(rjs["ids"]), std::end(rjs["ids"]));
+        next_cursor = decodeIdsPage(response_data, [&] (user_id found) {
+          page.push_back(found);
+        });
+
+        if (pending.valid() && (next_cursor != scanned))
+        {
+          pending = std::future<std::string>();
+        }
       } catch (const std::invalid_argument& error)
       {
         std::throw_with_nested(invalid_response(response_data));
@@ -212,95 +1092,181 @@ namespace twitter {
       {
         std::throw_with_nested(invalid_response(response_data));
       }
+
+      pool_->recycle(std::move(response_data));
+
+      cursor = next_cursor;
+
+      if (!callback(page, cursor))
+      {
+        break;
+      }
     }
 
-    return result;
+    return cursor;
   }
 
-  std::set<user_id> client::getFriends(const user& id) const
+  std::future<std::set<user_id>> client::getFriendsAsync(user_id id) const
   {
-    return getFriends(id.getID());
+    auto promise = std::make_shared<std::promise<std::set<user_id>>>();
+    std::future<std::set<user_id>> result = promise->get_future();
+
+    walkIdsAsync(
+      "https://api.twitter.com/1.1/friends/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      std::make_shared<std::set<user_id>>(),
+      std::move(promise));
+
+    return result;
   }
 
-  std::set<user_id> client::getFriends() const
+  std::future<std::set<user_id>> client::getFollowersAsync(user_id id) const
   {
-    return getFriends(getUser().getID());
+    auto promise = std::make_shared<std::promise<std::set<user_id>>>();
+    std::future<std::set<user_id>> result = promise->get_future();
+
+    walkIdsAsync(
+      "https://api.twitter.com/1.1/followers/ids.json?user_id=" +
+        std::to_string(id) + "&cursor=",
+      -1,
+      std::make_shared<std::set<user_id>>(),
+      std::move(promise));
+
+    return result;
   }
 
-  std::set<user_id> client::getFollowers(user_id id) const
+  std::future<std::set<user_id>> client::getBlocksAsync() const
   {
-    long long cursor = -1;
-    std::set<user_id> result;
+    auto promise = std::make_shared<std::promise<std::set<user_id>>>();
+    std::future<std::set<user_id>> result = promise->get_future();
 
-    while (cursor != 0)
-    {
-      std::stringstream urlstream;
-      urlstream << "https://api.twitter.com/1.1/followers/ids.json?user_id=";
-      urlstream << id;
-      urlstream << "&cursor=";
-      urlstream << cursor;
+    walkIdsAsync(
+      "https://api.twitter.com/1.1/blocks/ids.json?cursor=",
+      -1,
+      std::make_shared<std::set<user_id>>(),
+      std::move(promise));
 
-      std::string url = urlstream.str();
-      std::string response_data = get(auth_, url).perform();
+    return result;
+  }
 
-      try
-      {
-        nlohmann::json rjs = nlohmann::json::parse(response_data);
+  std::future<std::string> client::fetchAsync(std::string url) const
+  {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> result = promise->get_future();
 
-        cursor = rjs["next_cursor"].get<long long>();
-        result.insert(std::begin(rjs["ids"]), std::end(rjs["ids"]));
-      } catch (const std::invalid_argument& error)
-      {
-        std::throw_with_nested(invalid_response(response_data));
-      } catch (const std::domain_error& error)
-      {
-        std::throw_with_nested(invalid_response(response_data));
-      }
-    }
+    fetchAsync(std::move(url), promise, 1, retry_policy::clock::now());
 
     return result;
   }
 
-  std::set<user_id> client::getFollowers(const user& id) const
+  void client::fetchAsync(
+    std::string url,
+    std::shared_ptr<std::promise<std::string>> promise,
+    size_t attempt,
+    retry_policy::clock::time_point start) const
   {
-    return getFollowers(id.getID());
+    submit(
+      std::make_unique<get>(auth_, url, pool_.get(), limiter_.get()),
+      [=] (std::string response_data) {
+        promise->set_value(std::move(response_data));
+      },
+      [=] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
+
+        if (retry_.shouldRetry(error, attempt, start, delay))
+        {
+          schedule(
+            retry_policy::clock::now() + delay,
+            [=] () {
+              fetchAsync(url, promise, attempt + 1, start);
+            });
+        } else {
+          promise->set_exception(error);
+        }
+      });
   }
 
-  std::set<user_id> client::getFollowers() const
+  void client::verifyAsync(
+    std::string url,
+    std::shared_ptr<std::promise<user>> promise,
+    size_t attempt,
+    retry_policy::clock::time_point start) const
   {
-    return getFollowers(getUser().getID());
+    // The user is decoded on the engine, so that the future becomes ready
+    // without anybody waiting on it.
+    submit(
+      std::make_unique<get>(auth_, url, pool_.get(), limiter_.get()),
+      [=] (std::string response_data) {
+        promise->set_value(decodeObject<user>(response_data));
+      },
+      [=] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
+
+        if (retry_.shouldRetry(error, attempt, start, delay))
+        {
+          schedule(
+            retry_policy::clock::now() + delay,
+            [=] () {
+              verifyAsync(url, promise, attempt + 1, start);
+            });
+        } else {
+          promise->set_exception(error);
+        }
+      });
   }
 
-  std::set<user_id> client::getBlocks() const
+  void client::walkIdsAsync(
+    std::string url,
+    long long cursor,
+    std::shared_ptr<std::set<user_id>> result,
+    std::shared_ptr<std::promise<std::set<user_id>>> promise,
+    size_t attempt,
+    retry_policy::clock::time_point start) const
   {
-    long long cursor = -1;
-    std::set<user_id> result;
+    std::string pageUrl = url + std::to_string(cursor);
 
-    while (cursor != 0)
-    {
-      std::stringstream urlstream;
-      urlstream << "https://api.twitter.com/1.1/blocks/ids.json?cursor=";
-      urlstream << cursor;
+    submit(
+      std::make_unique<get>(auth_, pageUrl, pool_.get(), limiter_.get()),
+      [=] (std::string response_data) {
+        long long next_cursor;
 
-      std::string url = urlstream.str();
-      std::string response_data = get(auth_, url).perform();
+        try
+        {
+          next_cursor = decodeIdsPage(response_data, [&] (user_id found) {
+            result->insert(std::end(*result), found);
+          });
+        } catch (const std::invalid_argument& error)
+        {
+          std::throw_with_nested(invalid_response(response_data));
+        } catch (const std::domain_error& error)
+        {
+          std::throw_with_nested(invalid_response(response_data));
+        }
 
-      try
-      {
-        nlohmann::json rjs = nlohmann::json::parse(response_data);
+        pool_->recycle(std::move(response_data));
 
-        cursor = rjs["next_cursor"].get<long long>();
-        result.insert(std::begin(rjs["ids"]), std::end(rjs["ids"]));
-      } catch (const std::invalid_argument& error)
-      {
-        std::throw_with_nested(invalid_response(response_data));
-      } catch (const std::domain_error& error)
-      {
-        std::throw_with_nested(invalid_response(response_data));
-      }
-    }
+        if (next_cursor == 0)
+        {
+          promise->set_value(std::move(*result));
+        } else {
+          walkIdsAsync(url, next_cursor, result, promise);
+        }
+      },
+      [=] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
 
-    return result;
+        if (retry_.shouldRetry(error, attempt, start, delay))
+        {
+          schedule(
+            retry_policy::clock::now() + delay,
+            [=] () {
+              walkIdsAsync(url, cursor, result, promise, attempt + 1, start);
+            });
+        } else {
+          promise->set_exception(error);
+        }
+      });
   }
 
   void client::follow(user_id toFollow) const
@@ -309,7 +1275,7 @@ namespace twitter {
     datastrstream << "follow=true&user_id=";
     datastrstream << toFollow;
 
-    post(auth_, "https://api.twitter.com/1.1/friendships/create.json", datastrstream.str()).perform();
+    post(auth_, "https://api.twitter.com/1.1/friendships/create.json", datastrstream.str(), pool_.get(), limiter_.get()).perform();
   }
 
   void client::follow(const user& toFollow) const
@@ -323,7 +1289,7 @@ namespace twitter {
     datastrstream << "user_id=";
     datastrstream << toUnfollow;
 
-    post(auth_, "https://api.twitter.com/1.1/friendships/destroy.json", datastrstream.str()).perform();
+    post(auth_, "https://api.twitter.com/1.1/friendships/destroy.json", datastrstream.str(), pool_.get(), limiter_.get()).perform();
   }
 
   void client::unfollow(const user& toUnfollow) const
@@ -333,66 +1299,333 @@ namespace twitter {
 
   const user& client::getUser() const
   {
-    return currentUser_;
+    return currentUser_.get();
   }
 
   const configuration& client::getConfiguration() const
   {
-    if (!_configuration || (difftime(time(NULL), _last_configuration_update) > 60*60*24))
+    return *getConfigurationSnapshot();
+  }
+
+  std::shared_ptr<const configuration> client::getConfigurationSnapshot() const
+  {
+    const double lifetime = 60*60*24;
+
+    std::shared_ptr<const configuration> current = std::atomic_load(&_configuration);
+
+    if (current)
+    {
+      double age = difftime(time(NULL), _last_configuration_update);
+      std::chrono::seconds lead = configurationRefreshAhead_;
+
+      if (lead.count() > 0)
+      {
+        if (age > lifetime - lead.count())
+        {
+          refreshConfigurationAsync();
+        }
+
+        return current;
+      } else if (age <= lifetime)
+      {
+        return current;
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(configurationMutex_, std::defer_lock);
+
+    if (current)
     {
-      _configuration =
-        std::make_unique<configuration>(
-          get(auth_,
-            "https://api.twitter.com/1.1/help/configuration.json")
-          .perform());
+      // Somebody else is already refreshing it.
+      if (!lock.try_lock())
+      {
+        return current;
+      }
+    } else {
+      lock.lock();
+    }
+
+    current = std::atomic_load(&_configuration);
 
-      _last_configuration_update = time(NULL);
+    if (current && (difftime(time(NULL), _last_configuration_update) <= lifetime))
+    {
+      return current;
     }
 
-    return *_configuration;
+    std::string data = retry_.run([&] () {
+      return get(auth_,
+        "https://api.twitter.com/1.1/help/configuration.json",
+        pool_.get(),
+        limiter_.get())
+      .perform();
+    });
+
+    std::shared_ptr<const configuration> fresh =
+      std::make_shared<configuration>(decodeObject<configuration>(data));
+
+    installConfiguration(fresh, time(NULL), data);
+
+    return fresh;
   }
 
-  std::list<tweet> client::hydrateTweets(std::set<tweet_id> ids) const
+  void client::setConfigurationCache(std::string path)
   {
-    std::list<tweet> result;
+    configurationCache_ = std::move(path);
 
-    while (!ids.empty())
+    std::string data;
+    struct stat info;
+
+    try
+    {
+      if (!readFile(configurationCache_, data) ||
+        (stat(configurationCache_.c_str(), &info) != 0))
+      {
+        return;
+      }
+    } catch (const storage_error& error)
     {
-      std::set<tweet_id> cur;
+      return;
+    }
 
-      for (int i = 0; i < 100 && !ids.empty(); i++)
+    std::shared_ptr<const configuration> cached;
+
+    try
+    {
+      cached = std::make_shared<configuration>(decodeObject<configuration>(data));
+    } catch (const invalid_response& error)
+    {
+      // A damaged cache is no worse than none.
+      return;
+    }
+
+    if (!std::atomic_load(&_configuration) ||
+      (info.st_mtime > _last_configuration_update))
+    {
+      installConfiguration(cached, info.st_mtime, "");
+    }
+  }
+
+  void client::installConfiguration(
+    std::shared_ptr<const configuration> fresh,
+    time_t fetched,
+    const std::string& data) const
+  {
+    {
+      std::lock_guard<std::mutex> lock(snapshotMutex_);
+
+      std::shared_ptr<const configuration> old = std::atomic_load(&_configuration);
+      if (old)
       {
-        cur.insert(*std::begin(ids));
-        ids.erase(std::begin(ids));
+        oldConfigurations_.push_back(std::move(old));
+
+        if (oldConfigurations_.size() > keptConfigurations)
+        {
+          oldConfigurations_.pop_front();
+        }
       }
 
-      std::string datastr = "id=" +
-        OAuth::PercentEncode(
-          hatkirby::implode(std::begin(cur), std::end(cur), ","));
+      std::atomic_store(&_configuration, fresh);
+      _last_configuration_update = fetched;
+    }
+
+    if (configurationCache_.empty() || data.empty())
+    {
+      return;
+    }
+
+    if (!engine_->onLoopThread())
+    {
+      cacheConfiguration(configurationCache_, data);
+
+      return;
+    }
+
+    // Writing and syncing the file would hold up every other transfer, so
+    // it gets a thread of its own, which the destructor waits for.
+    std::shared_ptr<lifeline> life = lifeline_;
+
+    {
+      std::lock_guard<std::mutex> lock(life->mutex);
+
+      life->active++;
+    }
 
-      std::string response =
-        post(auth_,
-          "https://api.twitter.com/1.1/statuses/lookup.json",
-          datastr).perform();
+    try
+    {
+      std::thread([life, path = configurationCache_, data] () {
+        cacheConfiguration(path, data);
+
+        life->release();
+      }).detach();
+    } catch (const std::system_error& error)
+    {
+      cacheConfiguration(configurationCache_, data);
 
-      nlohmann::json rjs = nlohmann::json::parse(response);
+      life->release();
+    }
+  }
+
+  void client::refreshConfigurationAsync() const
+  {
+    {
+      std::lock_guard<std::mutex> lock(refreshMutex_);
 
-      for (auto& single : rjs)
+      if (refreshing_ || (time(NULL) < refreshRetryAt_))
       {
-        result.emplace_back(single.dump());
+        return;
       }
+
+      refreshing_ = true;
     }
 
-    return result;
+    auto done = [this] (bool succeeded) {
+      if (!succeeded)
+      {
+        refreshRetryAt_ = time(NULL) + 60;
+      }
+
+      std::lock_guard<std::mutex> lock(refreshMutex_);
+
+      refreshing_ = false;
+      refreshDone_.notify_all();
+    };
+
+    try
+    {
+      submit(
+        std::make_unique<get>(auth_,
+          "https://api.twitter.com/1.1/help/configuration.json",
+          pool_.get(),
+          limiter_.get()),
+        [this, done] (std::string data) {
+          bool succeeded = false;
+
+          try
+          {
+            installConfiguration(
+              std::make_shared<configuration>(decodeObject<configuration>(data)),
+              time(NULL),
+              data);
+
+            succeeded = true;
+          } catch (const invalid_response& error)
+          {
+            // Keep using the current configuration.
+          }
+
+          done(succeeded);
+        },
+        [done] (std::exception_ptr) {
+          done(false);
+        });
+    } catch (...)
+    {
+      done(false);
+    }
+  }
+
+  std::list<tweet> client::hydrateTweets(std::set<tweet_id> ids) const
+  {
+    requireOffLoop(*engine_, "hydrateTweets");
+
+    return hydrateTweetsAsync(std::move(ids)).get();
   }
 
   std::list<user> client::hydrateUsers(std::set<user_id> ids) const
   {
-    std::list<user> result;
+    requireOffLoop(*engine_, "hydrateUsers");
+
+    return hydrateUsersAsync(std::move(ids)).get();
+  }
+
+  std::future<std::list<tweet>> client::hydrateTweetsAsync(std::set<tweet_id> ids) const
+  {
+    user_table* users = users_.get();
+    tweet_store* store = tweetStore_;
+    std::list<tweet> held;
+
+    if (store)
+    {
+      for (auto it = std::begin(ids); it != std::end(ids);)
+      {
+        if (std::shared_ptr<const tweet> found = store->find(*it))
+        {
+          held.push_back(*found);
+          it = ids.erase(it);
+        } else {
+          it++;
+        }
+      }
+    }
+
+    return hydrateAsync<tweet>(
+      "https://api.twitter.com/1.1/statuses/lookup.json",
+      "id",
+      std::move(ids),
+      [users, store] (decoder& input) {
+        tweet result(input, users);
+
+        if (store)
+        {
+          store->insert(result);
+        }
+
+        return result;
+      },
+      std::move(held));
+  }
+
+  std::future<std::list<user>> client::hydrateUsersAsync(std::set<user_id> ids) const
+  {
+    user_table* users = users_.get();
+
+    return hydrateAsync<user>(
+      "https://api.twitter.com/1.1/users/lookup.json",
+      "user_id",
+      std::move(ids),
+      [users] (decoder& input) {
+        user result(input);
+        users->intern(result);
+
+        return result;
+      });
+  }
+
+  template <typename Object>
+  struct client::hydration {
+    std::string url;
+    std::function<Object(decoder&)> decode;
+    std::vector<std::string> datastrs;
+    std::vector<std::list<Object>> batches;
+    std::list<Object> held;
+    size_t next = 0;
+    size_t in_flight = 0;
+    std::vector<size_t> attempts;
+    retry_policy::clock::time_point start;
+    size_t remaining;
+    bool failed = false;
+    std::promise<std::list<Object>> promise;
+    std::mutex mutex;
+  };
+
+  template <typename Object, typename Id>
+  std::future<std::list<Object>> client::hydrateAsync(
+    std::string url,
+    std::string field,
+    std::set<Id> ids,
+    std::function<Object(decoder&)> decode,
+    std::list<Object> held) const
+  {
+    auto state = std::make_shared<hydration<Object>>();
+    std::future<std::list<Object>> result = state->promise.get_future();
+
+    state->url = std::move(url);
+    state->decode = std::move(decode);
+    state->held = std::move(held);
 
     while (!ids.empty())
     {
-      std::set<user_id> cur;
+      std::set<Id> cur;
 
       for (int i = 0; i < 100 && !ids.empty(); i++)
       {
@@ -400,24 +1633,169 @@ namespace twitter {
         ids.erase(std::begin(ids));
       }
 
-      std::string datastr = "user_id=" +
+      state->datastrs.push_back(field + "=" +
         OAuth::PercentEncode(
-          hatkirby::implode(std::begin(cur), std::end(cur), ","));
+          hatkirby::implode(std::begin(cur), std::end(cur), ",")));
+    }
+
+    if (state->datastrs.empty())
+    {
+      state->promise.set_value(std::move(state->held));
 
-      std::string response =
-        post(auth_,
-          "https://api.twitter.com/1.1/users/lookup.json",
-          datastr).perform();
+      return result;
+    }
 
-      nlohmann::json rjs = nlohmann::json::parse(response);
+    long reserve = hydrationReserve_;
+    rate_limiter::window window;
 
-      for (auto& single : rjs)
-      {
-        result.emplace_back(single.dump());
-      }
+    if ((reserve >= 0)
+      && limiter_->getWindow(rate_limiter::endpointOf(state->url), window)
+      && (window.reset > rate_limiter::clock::now())
+      && (window.remaining - static_cast<long>(state->datastrs.size()) < reserve))
+    {
+      state->promise.set_exception(
+        std::make_exception_ptr(
+          rate_limit_exceeded(
+            "Hydration needs " + std::to_string(state->datastrs.size()) +
+            " lookups but the window has " +
+            std::to_string(window.remaining) + " left")));
+
+      return result;
     }
 
+    state->batches.resize(state->datastrs.size());
+    state->attempts.resize(state->datastrs.size());
+    state->start = retry_policy::clock::now();
+    state->remaining = state->datastrs.size();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    dispatchHydration(state, lock);
+
     return result;
   }
 
+  template <typename Object>
+  void client::dispatchHydration(
+    std::shared_ptr<hydration<Object>> state,
+    std::unique_lock<std::mutex>& lock) const
+  {
+    size_t limit = std::max<size_t>(hydrationConcurrency_, 1);
+
+    while (!state->failed &&
+      state->in_flight < limit &&
+      state->next < state->datastrs.size())
+    {
+      size_t i = state->next++;
+      state->in_flight++;
+
+      // The engine may complete the request on its own thread before submit
+      // returns, so the state must not be held locked across it.
+      lock.unlock();
+
+      submitHydrationBatch(state, i);
+
+      lock.lock();
+    }
+  }
+
+  template <typename Object>
+  void client::submitHydrationBatch(
+    std::shared_ptr<hydration<Object>> state,
+    size_t i) const
+  {
+    submit(
+      std::make_unique<post>(auth_,
+        state->url,
+        state->datastrs[i],
+        pool_.get(),
+        limiter_.get()),
+      [this, state, i] (std::string response) {
+        std::list<Object> batch;
+
+        try
+        {
+          decoder input(response);
+          input.beginArray();
+
+          while (input.nextElement())
+          {
+            batch.push_back(state->decode(input));
+          }
+
+          input.finish();
+        } catch (const std::invalid_argument& error)
+        {
+          std::throw_with_nested(invalid_response(response));
+        } catch (const std::domain_error& error)
+        {
+          std::throw_with_nested(invalid_response(response));
+        }
+
+        pool_->recycle(std::move(response));
+
+        // The lookup endpoints return objects in no particular order, and
+        // each batch covers a contiguous range of the sorted ids.
+        batch.sort([] (const Object& left, const Object& right) {
+          return left.getID() < right.getID();
+        });
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        if (state->failed)
+        {
+          return;
+        }
+
+        state->batches[i] = std::move(batch);
+        state->in_flight--;
+
+        if (--state->remaining == 0)
+        {
+          std::list<Object> merged;
+
+          for (std::list<Object>& part : state->batches)
+          {
+            merged.splice(std::end(merged), part);
+          }
+
+          // Objects that were already at hand go in among the looked up
+          // ones, keeping the result sorted by id.
+          merged.merge(state->held,
+            [] (const Object& left, const Object& right) {
+              return left.getID() < right.getID();
+            });
+
+          state->promise.set_value(std::move(merged));
+        } else {
+          dispatchHydration(state, lock);
+        }
+      },
+      [this, state, i] (std::exception_ptr error) {
+        std::chrono::milliseconds delay;
+
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+
+          if (state->failed)
+          {
+            return;
+          }
+
+          if (!retry_.shouldRetry(error, ++state->attempts[i], state->start, delay))
+          {
+            state->failed = true;
+            state->promise.set_exception(error);
+
+            return;
+          }
+        }
+
+        schedule(
+          retry_policy::clock::now() + delay,
+          [this, state, i] () {
+            submitHydrationBatch(state, i);
+          });
+      });
+  }
+
 };
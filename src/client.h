@@ -3,24 +3,120 @@
 
 #include <list>
 #include <set>
+#include <vector>
 #include <ctime>
 #include <memory>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include "codes.h"
 #include "tweet.h"
 #include "auth.h"
 #include "configuration.h"
 #include "timeline.h"
+#include "connection_pool.h"
+#include "engine.h"
+#include "user_table.h"
+#include "rate_limiter.h"
+#include "retry_policy.h"
+#include "id_set.h"
+#include "tweet_store.h"
 
 namespace twitter {
 
+  // When a client checks its credentials and fetches its own user.
+  enum class verification {
+    // The constructor blocks until this is done, and throws if it fails.
+    immediate,
+
+    // The request is sent on the engine as the client is constructed.
+    background,
+
+    // The request is only sent once the user is first needed.
+    lazy
+  };
+
   class client {
   public:
 
     client(const auth& arg);
 
+    client(const auth& arg, std::shared_ptr<connection_pool> pool);
+
+    client(
+      const auth& arg,
+      std::shared_ptr<connection_pool> pool,
+      std::shared_ptr<engine> async,
+      verification mode = verification::immediate);
+
+    // Waits for background verification, configuration refresh and any
+    // transfers in flight to finish. Retries and status checks still waiting
+    // on a timer are dropped, so their futures fail with broken_promise.
+    // Must not be called from an engine callback.
+    ~client();
+
     tweet updateStatus(std::string msg, std::list<long> media_ids = {}) const;
+    std::future<tweet> updateStatusAsync(std::string msg, std::list<long> media_ids = {}) const;
     long uploadMedia(std::string media_type, const char* data, long data_length) const;
 
+    // Fills the buffer with up to length bytes of the media and returns how
+    // many it wrote.
+    using media_reader = std::function<size_t(char* buffer, size_t length)>;
+
+    // Reads exactly total_length bytes from the reader, one segment at a
+    // time, so that only the segments in flight are held in memory. Media
+    // of zero or negative length is rejected with std::invalid_argument.
+    long uploadMedia(
+      std::string media_type,
+      media_reader reader,
+      long total_length) const;
+
+    // Maps the file into memory rather than reading it. Throws storage_error
+    // if the file can't be opened.
+    long uploadMediaFile(std::string media_type, const std::string& path) const;
+
+    // These upload the media on the calling thread but leave waiting for
+    // Twitter to process it to the engine's timers. The future becomes ready
+    // with the media id once it can be attached to a tweet.
+    std::future<long> uploadMediaAsync(
+      std::string media_type,
+      const char* data,
+      long data_length) const;
+
+    std::future<long> uploadMediaAsync(
+      std::string media_type,
+      media_reader reader,
+      long total_length) const;
+
+    std::future<long> uploadMediaFileAsync(
+      std::string media_type,
+      const std::string& path) const;
+
+    // Media is uploaded in segments of this many bytes, with up to the
+    // given number of segments in flight at once.
+    size_t getMediaSegmentSize() const
+    {
+      return mediaSegmentSize_;
+    }
+
+    void setMediaSegmentSize(size_t size)
+    {
+      mediaSegmentSize_ = size;
+    }
+
+    size_t getMediaConcurrency() const
+    {
+      return mediaConcurrency_;
+    }
+
+    void setMediaConcurrency(size_t concurrency)
+    {
+      mediaConcurrency_ = concurrency;
+    }
+
     tweet replyToTweet(std::string msg, tweet_id in_response_to, std::list<long> media_ids = {}) const;
     tweet replyToTweet(std::string msg, const tweet& in_response_to, std::list<long> media_ids = {}) const;
 
@@ -34,16 +130,125 @@ namespace twitter {
 
     std::set<user_id> getBlocks() const;
 
+    id_set getFriendIds(user_id id) const;
+    id_set getFriendIds(const user& u) const;
+    id_set getFriendIds() const;
+
+    id_set getFollowerIds(user_id id) const;
+    id_set getFollowerIds(const user& u) const;
+    id_set getFollowerIds() const;
+
+    id_set getBlockIds() const;
+
+    // Called with each page of ids and the cursor of the page after it, which
+    // is zero after the last page. Returning false stops the walk.
+    using id_page_callback =
+      std::function<bool(const std::vector<user_id>& ids, long long next_cursor)>;
+
+    // Walks the id list one page at a time starting from the given cursor,
+    // so that huge lists can be processed in bounded memory and a walk can be
+    // checkpointed and resumed. Returns the cursor the walk stopped at, or
+    // zero if it reached the end.
+    long long walkFriends(
+      user_id id,
+      const id_page_callback& callback,
+      long long cursor = -1) const;
+
+    long long walkFollowers(
+      user_id id,
+      const id_page_callback& callback,
+      long long cursor = -1) const;
+
+    long long walkBlocks(
+      const id_page_callback& callback,
+      long long cursor = -1) const;
+
+    std::future<std::set<user_id>> getFriendsAsync(user_id id) const;
+    std::future<std::set<user_id>> getFollowersAsync(user_id id) const;
+    std::future<std::set<user_id>> getBlocksAsync() const;
+
     void follow(user_id toFollow) const;
     void follow(const user& toFollow) const;
 
     void unfollow(user_id toUnfollow) const;
     void unfollow(const user& toUnfollow) const;
 
+    // Waits for the credentials to be verified if they haven't been yet,
+    // and throws if that failed.
     const user& getUser() const;
 
+    // Becomes ready by itself once the credentials have been verified,
+    // except with lazy verification, where nothing is sent until get or
+    // wait is called.
+    std::shared_future<user> getUserAsync() const
+    {
+      return currentUser_;
+    }
+
+    const auth& getAuth() const
+    {
+      return auth_;
+    }
+
+    connection_pool& getConnectionPool() const
+    {
+      return *pool_;
+    }
+
+    engine& getEngine() const
+    {
+      return *engine_;
+    }
+
+    user_table& getUserTable() const
+    {
+      return *users_;
+    }
+
+    rate_limiter& getRateLimiter() const
+    {
+      return *limiter_;
+    }
+
+    const retry_policy& getRetryPolicy() const
+    {
+      return retry_;
+    }
+
+    // Unlike the other settings, the retry policy must not be replaced while
+    // the client is in use on other threads.
+    void setRetryPolicy(retry_policy policy)
+    {
+      retry_ = std::move(policy);
+    }
+
+    // Fetches the configuration the first time and refreshes it once a day.
+    // While one thread refreshes it, the others keep getting the previous
+    // snapshot.
+    std::shared_ptr<const configuration> getConfigurationSnapshot() const;
+
+    // The reference stays valid for a week's worth of refreshes at most.
+    [[deprecated("use getConfigurationSnapshot")]]
     const configuration& getConfiguration() const;
 
+    // Keeps a copy of the configuration in this file, and loads it from
+    // there right away if it holds one, so that a restarted process doesn't
+    // have to wait for Twitter. Set this before sharing the client.
+    void setConfigurationCache(std::string path);
+
+    // When non-zero, a configuration that is this close to its daily expiry
+    // is refreshed on the engine while the current one keeps being returned,
+    // even once it has expired. This also covers a stale cached copy.
+    std::chrono::seconds getConfigurationRefreshAhead() const
+    {
+      return configurationRefreshAhead_;
+    }
+
+    void setConfigurationRefreshAhead(std::chrono::seconds lead)
+    {
+      configurationRefreshAhead_ = lead;
+    }
+
     timeline& getHomeTimeline()
     {
       return homeTimeline_;
@@ -54,25 +259,212 @@ namespace twitter {
       return mentionsTimeline_;
     }
 
+    // The synchronous calls that wait on the engine, hydration and every
+    // media upload, throw std::logic_error when called from an engine
+    // callback instead of deadlocking.
     std::list<tweet> hydrateTweets(std::set<tweet_id> ids) const;
 
     std::list<user> hydrateUsers(std::set<user_id> ids) const;
 
+    // Fetches the URL on the engine, retrying failures under the client's
+    // retry policy.
+    std::future<std::string> fetchAsync(std::string url) const;
+
+    std::future<std::list<tweet>> hydrateTweetsAsync(std::set<tweet_id> ids) const;
+
+    std::future<std::list<user>> hydrateUsersAsync(std::set<user_id> ids) const;
+
+    size_t getHydrationConcurrency() const
+    {
+      return hydrationConcurrency_;
+    }
+
+    void setHydrationConcurrency(size_t concurrency)
+    {
+      hydrationConcurrency_ = concurrency;
+    }
+
+    // When not negative, a hydration first checks the lookup endpoint's
+    // rate limit window, and fails with rate_limit_exceeded before sending
+    // anything if it would leave fewer than this many calls in it. By
+    // default hydrations wait for the window to reset instead.
+    long getHydrationReserve() const
+    {
+      return hydrationReserve_;
+    }
+
+    void setHydrationReserve(long reserve)
+    {
+      hydrationReserve_ = reserve;
+    }
+
+    // Tweet hydration takes the tweets the store holds from it instead of
+    // looking them up, and adds the ones it looks up. The store must
+    // outlive the client; nullptr stops using it.
+    tweet_store* getTweetStore() const
+    {
+      return tweetStore_;
+    }
+
+    void setTweetStore(tweet_store* store)
+    {
+      tweetStore_ = store;
+    }
+
   private:
 
+    friend class timeline;
+
+    // Every transfer and timer the client, or a timeline's backfill, hands
+    // to the engine goes through these, so that the destructor can wait for
+    // them.
+    void submit(
+      std::unique_ptr<request> req,
+      engine::success_callback success,
+      engine::failure_callback failure) const;
+
+    void schedule(
+      std::chrono::steady_clock::time_point when,
+      std::function<void()> task) const;
+
+    // Only walks that read to the end prefetch, since a page requested
+    // before the callback stops the walk would be wasted.
+    long long walkIds(
+      std::string url,
+      long long cursor,
+      const id_page_callback& callback,
+      bool prefetch = false) const;
+
+    template <typename Object>
+    struct hydration;
+
+    template <typename Object, typename Id>
+    std::future<std::list<Object>> hydrateAsync(
+      std::string url,
+      std::string field,
+      std::set<Id> ids,
+      std::function<Object(decoder&)> decode,
+      std::list<Object> held = {}) const;
+
+    template <typename Object>
+    void dispatchHydration(
+      std::shared_ptr<hydration<Object>> state,
+      std::unique_lock<std::mutex>& lock) const;
+
+    template <typename Object>
+    void submitHydrationBatch(
+      std::shared_ptr<hydration<Object>> state,
+      size_t i) const;
+
+    struct media_segment;
+    struct media_upload;
+
+    long initMedia(const std::string& media_type, long total_length) const;
+
+    template <typename Source>
+    void appendMedia(long media_id, long total_length, Source source) const;
+
+    void submitMediaSegment(
+      std::shared_ptr<media_upload> upload,
+      std::shared_ptr<media_segment> segment,
+      size_t attempt,
+      retry_policy::clock::time_point start) const;
+
+    template <typename Source>
+    std::future<long> uploadSegmented(
+      const std::string& media_type,
+      long total_length,
+      Source source) const;
+
+    // Returns true if the media still has to be processed.
+    bool finalizeMedia(long media_id) const;
+
+    void pollMediaStatus(
+      long media_id,
+      std::shared_ptr<std::promise<long>> promise,
+      size_t attempt,
+      retry_policy::clock::time_point start) const;
+
+    void installConfiguration(
+      std::shared_ptr<const configuration> fresh,
+      time_t fetched,
+      const std::string& data) const;
+
+    void refreshConfigurationAsync() const;
+
+    void fetchAsync(
+      std::string url,
+      std::shared_ptr<std::promise<std::string>> promise,
+      size_t attempt,
+      retry_policy::clock::time_point start) const;
+
+    void verifyAsync(
+      std::string url,
+      std::shared_ptr<std::promise<user>> promise,
+      size_t attempt,
+      retry_policy::clock::time_point start) const;
+
+    void walkIdsAsync(
+      std::string url,
+      long long cursor,
+      std::shared_ptr<std::set<user_id>> result,
+      std::shared_ptr<std::promise<std::set<user_id>>> promise,
+      size_t attempt = 1,
+      retry_policy::clock::time_point start = retry_policy::clock::now()) const;
+
     const auth& auth_;
 
-    user currentUser_;
+    std::shared_ptr<connection_pool> pool_;
+
+    std::shared_ptr<engine> engine_;
+
+    struct lifeline;
+    std::shared_ptr<lifeline> lifeline_;
+
+    std::shared_ptr<user_table> users_;
+
+    std::shared_ptr<rate_limiter> limiter_;
+
+    retry_policy retry_;
+
+    std::atomic<size_t> hydrationConcurrency_ {4};
+    std::atomic<long> hydrationReserve_ {-1};
+    std::atomic<tweet_store*> tweetStore_ {nullptr};
+
+    std::atomic<size_t> mediaSegmentSize_ {1024 * 1024};
+    std::atomic<size_t> mediaConcurrency_ {4};
+
+    verification verification_;
+    std::shared_future<user> currentUser_;
+
+    // Read with std::atomic_load and replaced with std::atomic_store.
+    mutable std::shared_ptr<const configuration> _configuration;
+    mutable std::atomic<time_t> _last_configuration_update {0};
+
+    // Held by whichever thread is refreshing the configuration. The last few
+    // replaced snapshots are kept alive here, since getConfiguration may have
+    // handed out references to them.
+    mutable std::mutex configurationMutex_;
+    mutable std::mutex snapshotMutex_;
+    mutable std::list<std::shared_ptr<const configuration>> oldConfigurations_;
+
+    std::string configurationCache_;
+    std::atomic<std::chrono::seconds> configurationRefreshAhead_ {std::chrono::seconds(0)};
 
-    mutable std::unique_ptr<configuration> _configuration;
-    mutable time_t _last_configuration_update;
+    // Set while a background refresh is in flight, which the destructor
+    // waits out. After a failed one, another isn't tried until the retry
+    // time.
+    mutable std::mutex refreshMutex_;
+    mutable std::condition_variable refreshDone_;
+    mutable bool refreshing_ = false;
+    mutable std::atomic<time_t> refreshRetryAt_ {0};
 
     timeline homeTimeline_ {
-      auth_,
+      *this,
       "https://api.twitter.com/1.1/statuses/home_timeline.json"};
 
     timeline mentionsTimeline_ {
-      auth_,
+      *this,
       "https://api.twitter.com/1.1/statuses/mentions_timeline.json"};
   };
 
@@ -0,0 +1,191 @@
+#include "client_pool.h"
+#include <stdexcept>
+
+namespace twitter {
+
+  client_pool::client_pool() :
+    client_pool(
+      std::make_shared<connection_pool>(),
+      std::make_shared<engine>())
+  {
+  }
+
+  client_pool::client_pool(
+    std::shared_ptr<connection_pool> pool,
+    std::shared_ptr<engine> async) :
+      pool_(std::move(pool)),
+      engine_(std::move(async))
+  {
+  }
+
+  client& client_pool::add(
+    std::unique_ptr<auth> credentials,
+    verification mode)
+  {
+    std::unique_ptr<client> tclient(
+      new client(*credentials, pool_, engine_, mode));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    accounts_.push_back({std::move(credentials), std::move(tclient)});
+
+    return *accounts_.back().tclient;
+  }
+
+  std::vector<std::exception_ptr> client_pool::addAll(
+    std::vector<std::unique_ptr<auth>> credentials)
+  {
+    std::vector<account> pending;
+    pending.reserve(credentials.size());
+
+    for (std::unique_ptr<auth>& c : credentials)
+    {
+      std::unique_ptr<client> tclient(
+        new client(*c, pool_, engine_, verification::background));
+
+      pending.push_back({std::move(c), std::move(tclient)});
+    }
+
+    std::vector<std::exception_ptr> result(pending.size());
+    std::vector<account> verified;
+
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+      try
+      {
+        pending[i].tclient->getUser();
+
+        verified.push_back(std::move(pending[i]));
+      } catch (...)
+      {
+        result[i] = std::current_exception();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (account& a : verified)
+    {
+      accounts_.push_back(std::move(a));
+    }
+
+    return result;
+  }
+
+  size_t client_pool::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return accounts_.size();
+  }
+
+  client& client_pool::at(size_t index) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return *accounts_.at(index).tclient;
+  }
+
+  client* client_pool::find(user_id id) const
+  {
+    std::vector<client*> candidates;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      candidates.reserve(accounts_.size());
+
+      for (const account& a : accounts_)
+      {
+        candidates.push_back(a.tclient.get());
+      }
+    }
+
+    for (client* candidate : candidates)
+    {
+      // A lazy verification is deferred until it is asked for, and asking
+      // would send the request and wait for it.
+      std::shared_future<user> verified = candidate->getUserAsync();
+      if (verified.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+        continue;
+      }
+
+      try
+      {
+        if (verified.get().getID() == id)
+        {
+          return candidate;
+        }
+      } catch (...)
+      {
+        // The account failed verification, so it isn't anybody.
+      }
+    }
+
+    return nullptr;
+  }
+
+  client& client_pool::route(const std::string& endpoint) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (accounts_.empty())
+    {
+      throw std::out_of_range("client_pool is empty");
+    }
+
+    rate_limiter::clock::time_point now = rate_limiter::clock::now();
+
+    // Ties are broken by starting from a different account each time, so
+    // that fresh accounts share the work instead of the first one taking it
+    // all.
+    size_t start = next_++ % accounts_.size();
+    client* best = nullptr;
+    long bestRemaining = 0;
+
+    for (size_t i = 0; i < accounts_.size(); i++)
+    {
+      client& candidate = *accounts_[(start + i) % accounts_.size()].tclient;
+
+      rate_limiter::window w;
+      long remaining = rate_limiter::defaultLimit(endpoint);
+
+      if (candidate.getRateLimiter().getWindow(endpoint, w))
+      {
+        remaining = (w.reset > now) ? w.remaining : w.limit;
+      }
+
+      if (!best || (remaining > bestRemaining))
+      {
+        best = &candidate;
+        bestRemaining = remaining;
+      }
+    }
+
+    return *best;
+  }
+
+  std::future<std::list<tweet>> client_pool::hydrateTweetsAsync(
+    std::set<tweet_id> ids) const
+  {
+    return route("statuses/lookup").hydrateTweetsAsync(std::move(ids));
+  }
+
+  std::future<std::list<user>> client_pool::hydrateUsersAsync(
+    std::set<user_id> ids) const
+  {
+    return route("users/lookup").hydrateUsersAsync(std::move(ids));
+  }
+
+  id_set client_pool::getFriendIds(user_id id) const
+  {
+    return route("friends/ids").getFriendIds(id);
+  }
+
+  id_set client_pool::getFollowerIds(user_id id) const
+  {
+    return route("followers/ids").getFollowerIds(id);
+  }
+
+}
@@ -0,0 +1,104 @@
+#ifndef CLIENT_POOL_H_C41D7E09
+#define CLIENT_POOL_H_C41D7E09
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "auth.h"
+#include "client.h"
+#include "connection_pool.h"
+#include "engine.h"
+#include "id_set.h"
+
+namespace twitter {
+
+  // Holds clients for many accounts that share one connection pool and one
+  // engine. Each account keeps its own rate limits, and read-only work that
+  // any account can do is routed to whichever one has the most calls left
+  // for the endpoint involved.
+  class client_pool {
+  public:
+
+    client_pool();
+
+    client_pool(
+      std::shared_ptr<connection_pool> pool,
+      std::shared_ptr<engine> async);
+
+    client_pool(const client_pool& other) = delete;
+    client_pool& operator=(const client_pool& other) = delete;
+
+    // Returns the new account's client, which lives as long as the pool
+    // does.
+    client& add(
+      std::unique_ptr<auth> credentials,
+      verification mode = verification::immediate);
+
+    // Verifies all of the accounts at once on the engine and adds the ones
+    // that pass. The result has an entry for each account, in order, which
+    // holds the error if it was left out.
+    std::vector<std::exception_ptr> addAll(
+      std::vector<std::unique_ptr<auth>> credentials);
+
+    size_t size() const;
+
+    client& at(size_t index) const;
+
+    // Returns nullptr if no account in the pool is this user. Never waits:
+    // accounts whose verification hasn't finished, or failed, are skipped,
+    // as are lazy ones nobody has asked for the user of yet.
+    client* find(user_id id) const;
+
+    // Returns the client with the most calls left in its window for the
+    // endpoint, e.g. "statuses/lookup". Accounts that haven't used the
+    // endpoint yet count as having the documented limit for it left, and
+    // those whose window has reset as having their last limit left. Throws
+    // std::out_of_range if the pool is empty.
+    client& route(const std::string& endpoint) const;
+
+    std::future<std::list<tweet>> hydrateTweetsAsync(std::set<tweet_id> ids) const;
+
+    std::future<std::list<user>> hydrateUsersAsync(std::set<user_id> ids) const;
+
+    id_set getFriendIds(user_id id) const;
+
+    id_set getFollowerIds(user_id id) const;
+
+    connection_pool& getConnectionPool() const
+    {
+      return *pool_;
+    }
+
+    engine& getEngine() const
+    {
+      return *engine_;
+    }
+
+  private:
+
+    struct account {
+      std::unique_ptr<auth> credentials;
+      std::unique_ptr<client> tclient;
+    };
+
+    std::shared_ptr<connection_pool> pool_;
+
+    mutable std::mutex mutex_;
+    std::deque<account> accounts_;
+    mutable std::atomic<size_t> next_ {0};
+
+    // Each client waits for its own transfers as it is destroyed, and the
+    // last one to go stops the engine.
+    std::shared_ptr<engine> engine_;
+  };
+
+}
+
+#endif /* end of include guard: CLIENT_POOL_H_C41D7E09 */
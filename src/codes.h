@@ -178,6 +178,13 @@ namespace twitter {
     std::string _type;
   };
 
+  // Thrown when state kept on local disk can't be read or written.
+  class storage_error : public std::runtime_error {
+  public:
+
+    using std::runtime_error::runtime_error;
+  };
+
 };
 
 #endif /* end of include guard: CODES_H_05838D39 */
@@ -2,26 +2,34 @@
 #include <json.hpp>
 #include <cassert>
 #include "codes.h"
+#include "decoder.h"
 
 namespace twitter {
 
-  configuration::configuration(std::string data) try
+  configuration::configuration(std::string data) try :
+    configuration(nlohmann::json::parse(data))
   {
-    auto json_data = nlohmann::json::parse(data);
+  } catch (const std::invalid_argument& error)
+  {
+    std::throw_with_nested(malformed_object("configuration", data));
+  }
 
-    _characters_reserved_per_media = json_data["characters_reserved_per_media"].get<size_t>();
-    _dm_text_character_limit = json_data["dm_text_character_limit"].get<size_t>();
-    _max_media_per_upload = json_data["max_media_per_upload"].get<size_t>();
-    _photo_size_limit = json_data["photo_size_limit"].get<size_t>();
-    _short_url_length = json_data["short_url_length"].get<size_t>();
-    _short_https_url_length = json_data["short_url_length_https"].get<size_t>();
+  configuration::configuration(const nlohmann::json& json_data) try
+  {
+    _characters_reserved_per_media = json_data.at("characters_reserved_per_media").get<size_t>();
+    _dm_text_character_limit = json_data.at("dm_text_character_limit").get<size_t>();
+    _max_media_per_upload = json_data.at("max_media_per_upload").get<size_t>();
+    _photo_size_limit = json_data.at("photo_size_limit").get<size_t>();
+    _short_url_length = json_data.at("short_url_length").get<size_t>();
+    _short_https_url_length = json_data.at("short_url_length_https").get<size_t>();
 
-    for (auto sizedata = std::begin(json_data["photo_sizes"]); sizedata != std::end(json_data["photo_sizes"]); ++sizedata)
+    const nlohmann::json& photo_sizes = json_data.at("photo_sizes");
+    for (auto sizedata = std::begin(photo_sizes); sizedata != std::end(photo_sizes); ++sizedata)
     {
       photosize size;
-      size.height = sizedata.value()["h"].get<size_t>();
-      size.width = sizedata.value()["w"].get<size_t>();
-      if (sizedata.value()["resize"].get<std::string>() == "fit")
+      size.height = sizedata.value().at("h").get<size_t>();
+      size.width = sizedata.value().at("w").get<size_t>();
+      if (sizedata.value().at("resize").get<std::string>() == "fit")
       {
         size.resize = resizetype::fit;
       } else {
@@ -31,16 +39,129 @@ namespace twitter {
       _photo_sizes[sizedata.key()] = size;
     }
 
-    for (auto path : json_data["non_username_paths"])
+    for (const auto& path : json_data.at("non_username_paths"))
     {
       _non_username_paths.insert(path.get<std::string>());
     }
-  } catch (const std::invalid_argument& error)
+  } catch (const std::out_of_range& error)
   {
-    std::throw_with_nested(malformed_object("configuration", data));
+    std::throw_with_nested(malformed_object("configuration", json_data.dump()));
   } catch (const std::domain_error& error)
   {
-    std::throw_with_nested(malformed_object("configuration", data));
+    std::throw_with_nested(malformed_object("configuration", json_data.dump()));
+  }
+
+  configuration::configuration(decoder& input)
+  {
+    try
+    {
+      int found = 0;
+
+      input.beginObject();
+
+      std::string key;
+      while (input.nextKey(key))
+      {
+        if (key == "characters_reserved_per_media")
+        {
+          _characters_reserved_per_media = input.readUnsigned();
+          found++;
+        } else if (key == "dm_text_character_limit")
+        {
+          _dm_text_character_limit = input.readUnsigned();
+          found++;
+        } else if (key == "max_media_per_upload")
+        {
+          _max_media_per_upload = input.readUnsigned();
+          found++;
+        } else if (key == "photo_size_limit")
+        {
+          _photo_size_limit = input.readUnsigned();
+          found++;
+        } else if (key == "short_url_length")
+        {
+          _short_url_length = input.readUnsigned();
+          found++;
+        } else if (key == "short_url_length_https")
+        {
+          _short_https_url_length = input.readUnsigned();
+          found++;
+        } else if (key == "photo_sizes")
+        {
+          input.beginObject();
+
+          std::string name;
+          while (input.nextKey(name))
+          {
+            photosize size;
+            int sizeFound = 0;
+
+            input.beginObject();
+
+            std::string sizeKey;
+            while (input.nextKey(sizeKey))
+            {
+              if (sizeKey == "h")
+              {
+                size.height = input.readUnsigned();
+                sizeFound++;
+              } else if (sizeKey == "w")
+              {
+                size.width = input.readUnsigned();
+                sizeFound++;
+              } else if (sizeKey == "resize")
+              {
+                if (input.readString() == "fit")
+                {
+                  size.resize = resizetype::fit;
+                } else {
+                  size.resize = resizetype::crop;
+                }
+
+                sizeFound++;
+              } else {
+                input.skipValue();
+              }
+            }
+
+            if (sizeFound != 3)
+            {
+              throw std::out_of_range("photo size is missing a required member");
+            }
+
+            _photo_sizes[name] = size;
+          }
+
+          found++;
+        } else if (key == "non_username_paths")
+        {
+          input.beginArray();
+
+          while (input.nextElement())
+          {
+            _non_username_paths.insert(input.readString());
+          }
+
+          found++;
+        } else {
+          input.skipValue();
+        }
+      }
+
+      if (found != 8)
+      {
+        throw std::out_of_range("configuration is missing a required member");
+      }
+    } catch (const std::out_of_range& error)
+    {
+      std::throw_with_nested(malformed_object("configuration", input.getData()));
+    } catch (const std::invalid_argument& error)
+    {
+      std::throw_with_nested(malformed_object("configuration", input.getData()));
+    } catch (const std::domain_error& error)
+    {
+      std::throw_with_nested(malformed_object("configuration", input.getData()));
+    }
   }
 
 };
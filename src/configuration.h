@@ -4,9 +4,12 @@
 #include <map>
 #include <string>
 #include <set>
+#include "../vendor/json/json.hpp"
 
 namespace twitter {
 
+  class decoder;
+
   class configuration {
   public:
     enum class resizetype {
@@ -22,6 +25,10 @@ namespace twitter {
 
     explicit configuration(std::string data);
 
+    explicit configuration(const nlohmann::json& data);
+
+    explicit configuration(decoder& input);
+
     size_t getCharactersReservedPerMedia() const
     {
       return _characters_reserved_per_media;
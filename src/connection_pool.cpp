@@ -0,0 +1,167 @@
+#include "connection_pool.h"
+
+namespace twitter {
+
+  connection_pool::lease::lease() :
+    handle_(new curl::curl_easy())
+  {
+  }
+
+  connection_pool::lease::lease(
+    connection_pool* pool,
+    std::string host,
+    std::unique_ptr<curl::curl_easy> handle) :
+      pool_(pool),
+      host_(std::move(host)),
+      handle_(std::move(handle))
+  {
+  }
+
+  connection_pool::lease::~lease()
+  {
+    if (pool_ && handle_)
+    {
+      pool_->release(host_, std::move(handle_));
+    }
+  }
+
+  connection_pool::connection_pool(
+    size_t maxIdlePerHost,
+    std::chrono::seconds idleTimeout) :
+      maxIdlePerHost_(maxIdlePerHost),
+      idleTimeout_(idleTimeout)
+  {
+  }
+
+  connection_pool::lease connection_pool::acquire(const std::string& url)
+  {
+    std::string host = hostOf(url);
+    std::unique_ptr<curl::curl_easy> handle;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      evictIdleLocked(std::chrono::steady_clock::now());
+
+      auto it = idle_.find(host);
+      if (it != std::end(idle_) && !it->second.empty())
+      {
+        // Most recently used first, since its connection is the least likely
+        // to have been closed by the server.
+        handle = std::move(it->second.back().handle);
+        it->second.pop_back();
+      }
+    }
+
+    if (handle)
+    {
+      // Clears every option set by the previous request but keeps the live
+      // connections, DNS cache and TLS session cache.
+      handle->reset();
+    } else {
+      handle.reset(new curl::curl_easy());
+    }
+
+    return lease(this, std::move(host), std::move(handle));
+  }
+
+  std::string connection_pool::takeBuffer()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (buffers_.empty())
+    {
+      return std::string();
+    }
+
+    std::string result = std::move(buffers_.back());
+    buffers_.pop_back();
+
+    return result;
+  }
+
+  void connection_pool::recycle(std::string buffer)
+  {
+    if (buffer.capacity() > maxBufferCapacity)
+    {
+      return;
+    }
+
+    buffer.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (buffers_.size() < maxBuffers)
+    {
+      buffers_.push_back(std::move(buffer));
+    }
+  }
+
+  void connection_pool::evictIdle()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    evictIdleLocked(std::chrono::steady_clock::now());
+  }
+
+  void connection_pool::setMaxIdlePerHost(size_t maxIdlePerHost)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    maxIdlePerHost_ = maxIdlePerHost;
+
+    for (auto& host : idle_)
+    {
+      while (host.second.size() > maxIdlePerHost_)
+      {
+        host.second.pop_front();
+      }
+    }
+  }
+
+  void connection_pool::setIdleTimeout(std::chrono::seconds idleTimeout)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    idleTimeout_ = idleTimeout;
+  }
+
+  std::string connection_pool::hostOf(const std::string& url)
+  {
+    std::string::size_type start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+
+    return url.substr(0, url.find_first_of("/?#", start));
+  }
+
+  void connection_pool::release(
+    const std::string& host,
+    std::unique_ptr<curl::curl_easy> handle)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::list<idle_handle>& handles = idle_[host];
+    if (handles.size() >= maxIdlePerHost_)
+    {
+      return;
+    }
+
+    handles.push_back({std::move(handle), std::chrono::steady_clock::now()});
+  }
+
+  void connection_pool::evictIdleLocked(
+    std::chrono::steady_clock::time_point now)
+  {
+    for (auto& host : idle_)
+    {
+      // Handles are appended as they are released, so the oldest are at the
+      // front.
+      while (!host.second.empty() &&
+        (now - host.second.front().since) > idleTimeout_)
+      {
+        host.second.pop_front();
+      }
+    }
+  }
+
+}
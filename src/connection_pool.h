@@ -0,0 +1,108 @@
+#ifndef CONNECTION_POOL_H_6E0B21D4
+#define CONNECTION_POOL_H_6E0B21D4
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <curl_easy.h>
+
+namespace twitter {
+
+  // Keeps finished curl handles around, keyed by scheme and host, so that
+  // later requests to the same host can reuse the handle's keep-alive
+  // connection, DNS cache and TLS session instead of opening new ones.
+  class connection_pool {
+  public:
+
+    class lease {
+    public:
+
+      // Creates an unpooled handle that is destroyed with the lease.
+      lease();
+
+      lease(
+        connection_pool* pool,
+        std::string host,
+        std::unique_ptr<curl::curl_easy> handle);
+
+      lease(lease&& other) = default;
+      lease& operator=(lease&& other) = default;
+
+      ~lease();
+
+      curl::curl_easy& get() const
+      {
+        return *handle_;
+      }
+
+    private:
+
+      connection_pool* pool_ = nullptr;
+      std::string host_;
+      std::unique_ptr<curl::curl_easy> handle_;
+    };
+
+    explicit connection_pool(
+      size_t maxIdlePerHost = 4,
+      std::chrono::seconds idleTimeout = std::chrono::seconds(60));
+
+    connection_pool(const connection_pool& other) = delete;
+    connection_pool& operator=(const connection_pool& other) = delete;
+
+    lease acquire(const std::string& url);
+
+    // Response bodies are read into buffers taken from the pool. Handing a
+    // buffer back once its contents have been decoded lets a later response
+    // reuse the allocation.
+    std::string takeBuffer();
+
+    void recycle(std::string buffer);
+
+    void evictIdle();
+
+    size_t getMaxIdlePerHost() const
+    {
+      return maxIdlePerHost_;
+    }
+
+    void setMaxIdlePerHost(size_t maxIdlePerHost);
+
+    std::chrono::seconds getIdleTimeout() const
+    {
+      return idleTimeout_;
+    }
+
+    void setIdleTimeout(std::chrono::seconds idleTimeout);
+
+  private:
+
+    struct idle_handle {
+      std::unique_ptr<curl::curl_easy> handle;
+      std::chrono::steady_clock::time_point since;
+    };
+
+    static std::string hostOf(const std::string& url);
+
+    void release(
+      const std::string& host,
+      std::unique_ptr<curl::curl_easy> handle);
+
+    void evictIdleLocked(std::chrono::steady_clock::time_point now);
+
+    static const size_t maxBuffers = 16;
+    static const size_t maxBufferCapacity = 8 * 1024 * 1024;
+
+    size_t maxIdlePerHost_;
+    std::chrono::seconds idleTimeout_;
+
+    std::mutex mutex_;
+    std::map<std::string, std::list<idle_handle>> idle_;
+    std::list<std::string> buffers_;
+  };
+
+}
+
+#endif /* end of include guard: CONNECTION_POOL_H_6E0B21D4 */
@@ -0,0 +1,551 @@
+#include "decoder.h"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace twitter {
+
+  static bool isValueStart(char c)
+  {
+    return (c == '{') || (c == '[') || (c == '"') || (c == '-')
+      || (c == 't') || (c == 'f') || (c == 'n')
+      || ((c >= '0') && (c <= '9'));
+  }
+
+  static void appendUtf8(std::string& out, unsigned long codepoint)
+  {
+    if (codepoint < 0x80)
+    {
+      out.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800)
+    {
+      out.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+      out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000)
+    {
+      out.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+  }
+
+  decoder::decoder(const char* begin, const char* end) :
+    begin_(begin),
+    end_(end),
+    cur_(begin),
+    first_(false)
+  {
+  }
+
+  decoder::decoder(const std::string& data) :
+    decoder(data.data(), data.data() + data.size())
+  {
+  }
+
+  void decoder::beginObject()
+  {
+    char c = peek();
+
+    if (c != '{')
+    {
+      if (isValueStart(c))
+      {
+        throw std::domain_error("type must be object");
+      }
+
+      syntaxError("expected object");
+    }
+
+    cur_++;
+    first_ = true;
+  }
+
+  bool decoder::nextKey(std::string& key)
+  {
+    char c = peek();
+
+    if (c == '}')
+    {
+      cur_++;
+      first_ = false;
+
+      return false;
+    }
+
+    if (!first_)
+    {
+      if (c != ',')
+      {
+        syntaxError("expected ',' or '}'");
+      }
+
+      cur_++;
+    }
+
+    first_ = false;
+
+    if (peek() != '"')
+    {
+      syntaxError("expected member name");
+    }
+
+    key = readString();
+    expect(':');
+
+    return true;
+  }
+
+  void decoder::beginArray()
+  {
+    char c = peek();
+
+    if (c != '[')
+    {
+      if (isValueStart(c))
+      {
+        throw std::domain_error("type must be array");
+      }
+
+      syntaxError("expected array");
+    }
+
+    cur_++;
+    first_ = true;
+  }
+
+  bool decoder::nextElement()
+  {
+    char c = peek();
+
+    if (c == ']')
+    {
+      cur_++;
+      first_ = false;
+
+      return false;
+    }
+
+    if (!first_)
+    {
+      if (c != ',')
+      {
+        syntaxError("expected ',' or ']'");
+      }
+
+      cur_++;
+      c = peek();
+    }
+
+    first_ = false;
+
+    if (!isValueStart(c))
+    {
+      syntaxError("expected value");
+    }
+
+    return true;
+  }
+
+  bool decoder::readNull()
+  {
+    if (peek() != 'n')
+    {
+      return false;
+    }
+
+    skipLiteral("null");
+
+    return true;
+  }
+
+  bool decoder::readBool()
+  {
+    char c = peek();
+
+    if (c == 't')
+    {
+      skipLiteral("true");
+
+      return true;
+    } else if (c == 'f')
+    {
+      skipLiteral("false");
+
+      return false;
+    } else if (isValueStart(c))
+    {
+      throw std::domain_error("type must be boolean");
+    }
+
+    syntaxError("expected boolean");
+  }
+
+  std::string decoder::readString()
+  {
+    char c = peek();
+
+    if (c != '"')
+    {
+      if (isValueStart(c))
+      {
+        throw std::domain_error("type must be string");
+      }
+
+      syntaxError("expected string");
+    }
+
+    const char* start = ++cur_;
+
+    // Most strings contain no escapes and can be copied in one go.
+    while ((cur_ != end_) && (*cur_ != '"') && (*cur_ != '\\'))
+    {
+      cur_++;
+    }
+
+    if (cur_ == end_)
+    {
+      syntaxError("unterminated string");
+    }
+
+    std::string result(start, cur_);
+
+    while (*cur_ != '"')
+    {
+      // At a backslash.
+      if (++cur_ == end_)
+      {
+        syntaxError("unterminated string");
+      }
+
+      switch (*cur_++)
+      {
+        case '"': result.push_back('"'); break;
+        case '\\': result.push_back('\\'); break;
+        case '/': result.push_back('/'); break;
+        case 'b': result.push_back('\b'); break;
+        case 'f': result.push_back('\f'); break;
+        case 'n': result.push_back('\n'); break;
+        case 'r': result.push_back('\r'); break;
+        case 't': result.push_back('\t'); break;
+
+        case 'u':
+        {
+          auto readHex = [this] () {
+            if (end_ - cur_ < 4)
+            {
+              syntaxError("truncated unicode escape");
+            }
+
+            unsigned long value = 0;
+
+            for (int i = 0; i < 4; i++)
+            {
+              char h = *cur_++;
+              value <<= 4;
+
+              if ((h >= '0') && (h <= '9'))
+              {
+                value |= h - '0';
+              } else if ((h >= 'a') && (h <= 'f'))
+              {
+                value |= h - 'a' + 10;
+              } else if ((h >= 'A') && (h <= 'F'))
+              {
+                value |= h - 'A' + 10;
+              } else {
+                syntaxError("invalid unicode escape");
+              }
+            }
+
+            return value;
+          };
+
+          unsigned long codepoint = readHex();
+
+          if ((codepoint >= 0xD800) && (codepoint <= 0xDBFF))
+          {
+            if ((end_ - cur_ < 2) || (cur_[0] != '\\') || (cur_[1] != 'u'))
+            {
+              syntaxError("unpaired surrogate");
+            }
+
+            cur_ += 2;
+            unsigned long low = readHex();
+
+            if ((low < 0xDC00) || (low > 0xDFFF))
+            {
+              syntaxError("unpaired surrogate");
+            }
+
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+          }
+
+          appendUtf8(result, codepoint);
+
+          break;
+        }
+
+        default:
+        {
+          syntaxError("invalid escape");
+        }
+      }
+
+      start = cur_;
+
+      while ((cur_ != end_) && (*cur_ != '"') && (*cur_ != '\\'))
+      {
+        cur_++;
+      }
+
+      if (cur_ == end_)
+      {
+        syntaxError("unterminated string");
+      }
+
+      result.append(start, cur_);
+    }
+
+    cur_++;
+
+    return result;
+  }
+
+  unsigned long long decoder::readUnsigned()
+  {
+    char c = peek();
+
+    if (c == '-')
+    {
+      throw std::domain_error("number must be unsigned");
+    } else if ((c < '0') || (c > '9'))
+    {
+      if (isValueStart(c))
+      {
+        throw std::domain_error("type must be number");
+      }
+
+      syntaxError("expected number");
+    }
+
+    const unsigned long long limit = std::numeric_limits<unsigned long long>::max();
+    unsigned long long result = 0;
+
+    while ((cur_ != end_) && (*cur_ >= '0') && (*cur_ <= '9'))
+    {
+      unsigned digit = *cur_++ - '0';
+
+      if (result > (limit - digit) / 10)
+      {
+        throw std::domain_error("number is out of range");
+      }
+
+      result = result * 10 + digit;
+    }
+
+    if ((cur_ != end_) && ((*cur_ == '.') || (*cur_ == 'e') || (*cur_ == 'E')))
+    {
+      throw std::domain_error("number must be an integer");
+    }
+
+    return result;
+  }
+
+  long long decoder::readInteger()
+  {
+    bool negative = (peek() == '-');
+
+    if (negative)
+    {
+      cur_++;
+    }
+
+    unsigned long long magnitude = readUnsigned();
+    unsigned long long limit = std::numeric_limits<long long>::max();
+
+    if (magnitude > limit + (negative ? 1 : 0))
+    {
+      throw std::domain_error("number is out of range");
+    }
+
+    if (negative)
+    {
+      return static_cast<long long>(0 - magnitude);
+    } else {
+      return static_cast<long long>(magnitude);
+    }
+  }
+
+  void decoder::skipValue()
+  {
+    char c = peek();
+
+    switch (c)
+    {
+      case '{':
+      case '[':
+      {
+        // Nested containers are only balanced, not validated, since nobody
+        // is going to look at what is inside them.
+        int depth = 0;
+
+        do
+        {
+          if (cur_ == end_)
+          {
+            syntaxError("unterminated container");
+          }
+
+          switch (*cur_)
+          {
+            case '"': skipString(); continue;
+            case '{':
+            case '[': depth++; break;
+            case '}':
+            case ']': depth--; break;
+          }
+
+          cur_++;
+        } while (depth > 0);
+
+        break;
+      }
+
+      case '"': skipString(); break;
+      case 't': skipLiteral("true"); break;
+      case 'f': skipLiteral("false"); break;
+      case 'n': skipLiteral("null"); break;
+
+      default:
+      {
+        if ((c == '-') || ((c >= '0') && (c <= '9')))
+        {
+          skipNumber();
+        } else {
+          syntaxError("expected value");
+        }
+      }
+    }
+  }
+
+  decoder decoder::captureValue()
+  {
+    peek();
+
+    const char* start = cur_;
+    skipValue();
+
+    return decoder(start, cur_);
+  }
+
+  void decoder::finish()
+  {
+    skipWhitespace();
+
+    if (cur_ != end_)
+    {
+      syntaxError("unexpected trailing data");
+    }
+  }
+
+  void decoder::skipWhitespace()
+  {
+    while ((cur_ != end_) &&
+      ((*cur_ == ' ') || (*cur_ == '\n') || (*cur_ == '\r') || (*cur_ == '\t')))
+    {
+      cur_++;
+    }
+  }
+
+  char decoder::peek()
+  {
+    skipWhitespace();
+
+    if (cur_ == end_)
+    {
+      syntaxError("unexpected end of input");
+    }
+
+    return *cur_;
+  }
+
+  void decoder::expect(char c)
+  {
+    if (peek() != c)
+    {
+      syntaxError("unexpected character");
+    }
+
+    cur_++;
+  }
+
+  void decoder::skipString()
+  {
+    // At the opening quote.
+    cur_++;
+
+    while (cur_ != end_)
+    {
+      const char* quote =
+        static_cast<const char*>(std::memchr(cur_, '"', end_ - cur_));
+
+      if (!quote)
+      {
+        break;
+      }
+
+      // The quote is escaped if it is preceded by an odd number of
+      // backslashes.
+      const char* slash = quote;
+      while ((slash != cur_) && (slash[-1] == '\\'))
+      {
+        slash--;
+      }
+
+      cur_ = quote + 1;
+
+      if ((quote - slash) % 2 == 0)
+      {
+        return;
+      }
+    }
+
+    syntaxError("unterminated string");
+  }
+
+  void decoder::skipNumber()
+  {
+    while ((cur_ != end_) &&
+      (((*cur_ >= '0') && (*cur_ <= '9'))
+        || (*cur_ == '-') || (*cur_ == '+') || (*cur_ == '.')
+        || (*cur_ == 'e') || (*cur_ == 'E')))
+    {
+      cur_++;
+    }
+  }
+
+  void decoder::skipLiteral(const char* literal)
+  {
+    size_t length = std::strlen(literal);
+
+    if ((static_cast<size_t>(end_ - cur_) < length) ||
+      (std::memcmp(cur_, literal, length) != 0))
+    {
+      syntaxError("invalid literal");
+    }
+
+    cur_ += length;
+  }
+
+  void decoder::syntaxError(const char* message) const
+  {
+    throw std::invalid_argument(
+      "parse error at byte " + std::to_string(cur_ - begin_) + ": " + message);
+  }
+
+}
@@ -0,0 +1,86 @@
+#ifndef DECODER_H_84D2E9B0
+#define DECODER_H_84D2E9B0
+
+#include <string>
+
+namespace twitter {
+
+  // A pull parser over a JSON document that lets objects read just the
+  // members they care about and skip over everything else without building
+  // a DOM. The decoded text must outlive the decoder.
+  //
+  // Syntax errors throw std::invalid_argument and values of the wrong type
+  // throw std::domain_error, matching what nlohmann::json throws.
+  class decoder {
+  public:
+
+    decoder(const char* begin, const char* end);
+
+    explicit decoder(const std::string& data);
+
+    void beginObject();
+
+    // Reads the key of the next member of the current object, leaving the
+    // decoder positioned at its value, or consumes the closing brace and
+    // returns false.
+    bool nextKey(std::string& key);
+
+    void beginArray();
+
+    // Positions the decoder at the next element of the current array, or
+    // consumes the closing bracket and returns false.
+    bool nextElement();
+
+    // Consumes a null and returns true if that is the next value.
+    bool readNull();
+
+    bool readBool();
+
+    std::string readString();
+
+    unsigned long long readUnsigned();
+
+    long long readInteger();
+
+    void skipValue();
+
+    // Skips over the next value and returns a decoder over just its text, so
+    // that it can be looked at later or out of order.
+    decoder captureValue();
+
+    // Checks that nothing but whitespace follows the last value read.
+    void finish();
+
+    std::string getData() const
+    {
+      return std::string(begin_, end_);
+    }
+
+  private:
+
+    void skipWhitespace();
+
+    char peek();
+
+    void expect(char c);
+
+    void skipString();
+
+    void skipNumber();
+
+    void skipLiteral(const char* literal);
+
+    [[noreturn]] void syntaxError(const char* message) const;
+
+    const char* begin_;
+    const char* end_;
+    const char* cur_;
+
+    // Whether the container just begun has yet to give up a member or
+    // element, so that no comma is allowed before the next one.
+    bool first_;
+  };
+
+}
+
+#endif /* end of include guard: DECODER_H_84D2E9B0 */
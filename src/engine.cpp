@@ -0,0 +1,296 @@
+#include "engine.h"
+#include "codes.h"
+
+namespace twitter {
+
+  engine::engine() :
+    multi_(curl_multi_init())
+  {
+    if (!multi_)
+    {
+      throw connection_error();
+    }
+  }
+
+  engine::~engine()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      stopping_ = true;
+    }
+
+    if (thread_.joinable())
+    {
+      curl_multi_wakeup(multi_);
+      thread_.join();
+    }
+
+    for (auto& entry : active_)
+    {
+      curl_multi_remove_handle(multi_, entry.first);
+      fail(entry.second, std::make_exception_ptr(connection_error()));
+    }
+
+    for (transfer& t : incoming_)
+    {
+      fail(t, std::make_exception_ptr(connection_error()));
+    }
+
+    curl_multi_cleanup(multi_);
+  }
+
+  std::future<std::string> engine::submit(std::unique_ptr<request> req)
+  {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> result = promise->get_future();
+
+    submit(
+      std::move(req),
+      [promise] (std::string response) {
+        promise->set_value(std::move(response));
+      },
+      [promise] (std::exception_ptr error) {
+        promise->set_exception(error);
+      });
+
+    return result;
+  }
+
+  void engine::submit(
+    std::unique_ptr<request> req,
+    success_callback success,
+    failure_callback failure)
+  {
+    std::call_once(started_, [this] () {
+      thread_ = std::thread(&engine::run, this);
+    });
+
+    if (req->limiter_)
+    {
+      rate_limiter::clock::time_point retryAt;
+
+      if (!req->limiter_->tryAcquire(req->endpoint_, retryAt))
+      {
+        transfer t { std::move(req), std::move(success), std::move(failure) };
+
+        if (t.req->limiter_->getPolicy() == rate_policy::fail)
+        {
+          fail(t, std::make_exception_ptr(
+            rate_limit_exceeded(
+              "Rate limit window for " + t.req->endpoint_ + " is used up")));
+
+          return;
+        }
+
+        // Blocking may not hold up the loop thread, so the call waits for
+        // the window to reset on a timer instead. It has no connection yet.
+        auto deferred = std::make_shared<transfer>(std::move(t));
+
+        schedule(
+          std::chrono::steady_clock::now() +
+            (retryAt - rate_limiter::clock::now()),
+          [this, deferred] () {
+            submit(
+              std::move(deferred->req),
+              std::move(deferred->success),
+              std::move(deferred->failure));
+          });
+
+        return;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (stopping_)
+      {
+        transfer t { std::move(req), std::move(success), std::move(failure) };
+        fail(t, std::make_exception_ptr(connection_error()));
+
+        return;
+      }
+
+      incoming_.push_back({
+        std::move(req),
+        std::move(success),
+        std::move(failure)});
+    }
+
+    curl_multi_wakeup(multi_);
+  }
+
+  void engine::schedule(
+    std::chrono::steady_clock::time_point when,
+    std::function<void()> task)
+  {
+    std::call_once(started_, [this] () {
+      thread_ = std::thread(&engine::run, this);
+    });
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (stopping_)
+      {
+        return;
+      }
+
+      timers_.emplace(when, std::move(task));
+    }
+
+    curl_multi_wakeup(multi_);
+  }
+
+  void engine::run()
+  {
+    loopThread_ = std::this_thread::get_id();
+
+    for (;;)
+    {
+      std::list<transfer> added;
+      std::list<std::function<void()>> due;
+      int timeout = 1000;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stopping_)
+        {
+          return;
+        }
+
+        added.splice(std::end(added), incoming_);
+
+        auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && (std::begin(timers_)->first <= now))
+        {
+          due.push_back(std::move(std::begin(timers_)->second));
+          timers_.erase(std::begin(timers_));
+        }
+
+        if (!timers_.empty())
+        {
+          auto wait =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::begin(timers_)->first - now).count() + 1;
+
+          if (wait < timeout)
+          {
+            timeout = static_cast<int>(wait);
+          }
+        }
+      }
+
+      for (std::function<void()>& task : due)
+      {
+        try
+        {
+          task();
+        } catch (...)
+        {
+          // Timer tasks report their own failures.
+        }
+      }
+
+      for (transfer& t : added)
+      {
+        try
+        {
+          t.req->open();
+        } catch (...)
+        {
+          fail(t, std::current_exception());
+
+          continue;
+        }
+
+        CURL* handle = t.req->conn().get_curl();
+
+        if (curl_multi_add_handle(multi_, handle) != CURLM_OK)
+        {
+          fail(t, std::make_exception_ptr(connection_error()));
+        } else {
+          active_.emplace(handle, std::move(t));
+        }
+      }
+
+      int running = 0;
+      curl_multi_perform(multi_, &running);
+
+      int queued = 0;
+      while (CURLMsg* msg = curl_multi_info_read(multi_, &queued))
+      {
+        if (msg->msg != CURLMSG_DONE)
+        {
+          continue;
+        }
+
+        auto it = active_.find(msg->easy_handle);
+        if (it == std::end(active_))
+        {
+          continue;
+        }
+
+        CURLcode result = msg->data.result;
+        transfer t = std::move(it->second);
+
+        curl_multi_remove_handle(multi_, it->first);
+        active_.erase(it);
+
+        finish(t, result);
+      }
+
+      curl_multi_poll(multi_, nullptr, 0, timeout, nullptr);
+    }
+  }
+
+  void engine::finish(transfer& t, CURLcode result)
+  {
+    if (result != CURLE_OK)
+    {
+      fail(t, std::make_exception_ptr(connection_error()));
+
+      return;
+    }
+
+    std::string response;
+
+    try
+    {
+      response = t.req->complete();
+    } catch (...)
+    {
+      fail(t, std::current_exception());
+
+      return;
+    }
+
+    // Release the connection before handing over, so that a follow-up
+    // request submitted from the callback can reuse it.
+    t.req.reset();
+
+    try
+    {
+      t.success(std::move(response));
+    } catch (...)
+    {
+      fail(t, std::current_exception());
+    }
+  }
+
+  void engine::fail(transfer& t, std::exception_ptr error)
+  {
+    t.req.reset();
+
+    try
+    {
+      t.failure(error);
+    } catch (...)
+    {
+      // There is nobody left to report this to.
+    }
+  }
+
+}
@@ -0,0 +1,86 @@
+#ifndef ENGINE_H_1C7F5A92
+#define ENGINE_H_1C7F5A92
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <curl/curl.h>
+#include "request.h"
+
+namespace twitter {
+
+  // Runs many requests concurrently on a single curl_multi event loop. The
+  // loop thread is started by the first submission. Callbacks are invoked on
+  // the loop thread, so they should hand off any lengthy work; an exception
+  // thrown by a success callback is passed to the failure callback.
+  class engine {
+  public:
+
+    using success_callback = std::function<void(std::string)>;
+    using failure_callback = std::function<void(std::exception_ptr)>;
+
+    engine();
+
+    engine(const engine& other) = delete;
+    engine& operator=(const engine& other) = delete;
+
+    ~engine();
+
+    std::future<std::string> submit(std::unique_ptr<request> req);
+
+    void submit(
+      std::unique_ptr<request> req,
+      success_callback success,
+      failure_callback failure);
+
+    // Runs the task on the loop thread once the given time has passed.
+    void schedule(
+      std::chrono::steady_clock::time_point when,
+      std::function<void()> task);
+
+    // Waiting for a transfer from inside a callback would deadlock, so
+    // synchronous calls check this first.
+    bool onLoopThread() const
+    {
+      return std::this_thread::get_id() == loopThread_;
+    }
+
+  private:
+
+    struct transfer {
+      std::unique_ptr<request> req;
+      success_callback success;
+      failure_callback failure;
+    };
+
+    void run();
+
+    static void finish(transfer& t, CURLcode result);
+
+    static void fail(transfer& t, std::exception_ptr error);
+
+    CURLM* multi_;
+
+    std::mutex mutex_;
+    std::list<transfer> incoming_;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers_;
+    bool stopping_ = false;
+
+    std::map<CURL*, transfer> active_;
+
+    std::once_flag started_;
+    std::thread thread_;
+    std::atomic<std::thread::id> loopThread_ {std::thread::id()};
+  };
+
+}
+
+#endif /* end of include guard: ENGINE_H_1C7F5A92 */
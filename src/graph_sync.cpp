@@ -0,0 +1,181 @@
+#include "graph_sync.h"
+#include <vector>
+#include "client.h"
+#include "codes.h"
+#include "util.h"
+
+namespace twitter {
+
+  static const char snapshotMagic[4] = { 'T', 'W', 'G', '1' };
+
+  static void writeVarint(std::string& out, unsigned long long value)
+  {
+    while (value >= 0x80)
+    {
+      out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+
+    out.push_back(static_cast<char>(value));
+  }
+
+  static bool readVarint(
+    const char*& cur,
+    const char* end,
+    unsigned long long& value)
+  {
+    value = 0;
+
+    for (int shift = 0; (cur != end) && (shift < 64); shift += 7)
+    {
+      unsigned char byte = static_cast<unsigned char>(*cur++);
+      value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+
+      if (!(byte & 0x80))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  graph_sync::graph_sync(
+    const client& tclient,
+    std::string directory) :
+      client_(tclient),
+      directory_(std::move(directory))
+  {
+  }
+
+  graph_delta graph_sync::syncFriends(user_id id)
+  {
+    return sync(
+      "friends-" + std::to_string(id),
+      client_.getFriendIds(id));
+  }
+
+  graph_delta graph_sync::syncFollowers(user_id id)
+  {
+    return sync(
+      "followers-" + std::to_string(id),
+      client_.getFollowerIds(id));
+  }
+
+  graph_delta graph_sync::syncBlocks()
+  {
+    return sync(
+      "blocks-" + std::to_string(client_.getUser().getID()),
+      client_.getBlockIds());
+  }
+
+  graph_delta graph_sync::sync(const std::string& key, id_set current)
+  {
+    id_set previous;
+    loadSnapshot(key, previous);
+
+    graph_delta result;
+    result.added = current.difference(previous);
+    result.removed = previous.difference(current);
+
+    if (!directory_.empty() &&
+      (!result.added.empty() || !result.removed.empty()))
+    {
+      writeSnapshot(directory_ + "/" + key + ".ids", current);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    snapshots_[key] = std::move(current);
+
+    return result;
+  }
+
+  bool graph_sync::loadSnapshot(const std::string& key, id_set& ids)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      auto it = snapshots_.find(key);
+      if (it != std::end(snapshots_))
+      {
+        ids = it->second;
+
+        return true;
+      }
+    }
+
+    return !directory_.empty() &&
+      readSnapshot(directory_ + "/" + key + ".ids", ids);
+  }
+
+  void graph_sync::writeSnapshot(const std::string& path, const id_set& ids)
+  {
+    std::string data(snapshotMagic, sizeof(snapshotMagic));
+    data.reserve(data.size() + 10 + ids.size() * 3);
+
+    writeVarint(data, ids.size());
+
+    user_id last = 0;
+    for (user_id id : ids)
+    {
+      writeVarint(data, id - last);
+      last = id;
+    }
+
+    writeFileAtomically(path, data);
+  }
+
+  bool graph_sync::readSnapshot(const std::string& path, id_set& ids)
+  {
+    std::string data;
+    if (!readFile(path, data))
+    {
+      return false;
+    }
+
+    if ((data.size() < sizeof(snapshotMagic)) ||
+      (data.compare(0, sizeof(snapshotMagic),
+        snapshotMagic, sizeof(snapshotMagic)) != 0))
+    {
+      throw storage_error("Snapshot " + path + " is corrupt");
+    }
+
+    const char* cur = data.data() + sizeof(snapshotMagic);
+    const char* end = data.data() + data.size();
+
+    unsigned long long count;
+
+    if (!readVarint(cur, end, count) || (count > data.size()))
+    {
+      throw storage_error("Snapshot " + path + " is corrupt");
+    }
+
+    std::vector<user_id> result;
+    result.reserve(count);
+
+    user_id last = 0;
+    for (unsigned long long i = 0; i < count; i++)
+    {
+      unsigned long long gap;
+
+      if (!readVarint(cur, end, gap) || ((i > 0) && (gap == 0)))
+      {
+        throw storage_error("Snapshot " + path + " is corrupt");
+      }
+
+      last += gap;
+      result.push_back(last);
+    }
+
+    if (cur != end)
+    {
+      throw storage_error("Snapshot " + path + " is corrupt");
+    }
+
+    ids = id_set(std::move(result));
+
+    return true;
+  }
+
+}
@@ -0,0 +1,65 @@
+#ifndef GRAPH_SYNC_H_3F8B62E7
+#define GRAPH_SYNC_H_3F8B62E7
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "id_set.h"
+#include "user.h"
+
+namespace twitter {
+
+  class client;
+
+  struct graph_delta {
+    id_set added;
+    id_set removed;
+  };
+
+  // Remembers the last friend, follower and block lists seen for each
+  // account, so that each sync only has to report what changed since the
+  // previous one. When given a directory, snapshots are also stored there so
+  // that they survive a restart.
+  //
+  // An account that has no snapshot yet reports every id as added.
+  class graph_sync {
+  public:
+
+    explicit graph_sync(
+      const client& tclient,
+      std::string directory = "");
+
+    graph_sync(const graph_sync& other) = delete;
+    graph_sync& operator=(const graph_sync& other) = delete;
+
+    graph_delta syncFriends(user_id id);
+
+    graph_delta syncFollowers(user_id id);
+
+    graph_delta syncBlocks();
+
+    // Snapshots are stored as the number of ids followed by the gaps between
+    // consecutive sorted ids, all as varints, which takes two or three bytes
+    // per id for a typical list. The file is replaced atomically. Both
+    // functions throw storage_error.
+    static void writeSnapshot(const std::string& path, const id_set& ids);
+
+    // Returns false if there is no snapshot at the given path.
+    static bool readSnapshot(const std::string& path, id_set& ids);
+
+  private:
+
+    graph_delta sync(const std::string& key, id_set current);
+
+    bool loadSnapshot(const std::string& key, id_set& ids);
+
+    const client& client_;
+    std::string directory_;
+
+    std::mutex mutex_;
+    std::map<std::string, id_set> snapshots_;
+  };
+
+}
+
+#endif /* end of include guard: GRAPH_SYNC_H_3F8B62E7 */
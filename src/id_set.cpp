@@ -0,0 +1,106 @@
+#include "id_set.h"
+#include <algorithm>
+#include <iterator>
+
+namespace twitter {
+
+  // When one side is this many times larger than the other, looking each of
+  // the smaller side's ids up by binary search beats walking both.
+  static const size_t searchRatio = 32;
+
+  id_set::id_set(std::vector<user_id> ids) : ids_(std::move(ids))
+  {
+    std::sort(std::begin(ids_), std::end(ids_));
+    ids_.erase(std::unique(std::begin(ids_), std::end(ids_)), std::end(ids_));
+    ids_.shrink_to_fit();
+  }
+
+  bool id_set::contains(user_id id) const
+  {
+    return std::binary_search(std::begin(ids_), std::end(ids_), id);
+  }
+
+  id_set id_set::intersection(const id_set& other) const
+  {
+    const id_set& smaller = (size() <= other.size()) ? *this : other;
+    const id_set& larger = (size() <= other.size()) ? other : *this;
+
+    std::vector<user_id> result;
+    result.reserve(smaller.size());
+
+    if (larger.size() / searchRatio > smaller.size())
+    {
+      auto from = std::begin(larger.ids_);
+
+      for (user_id id : smaller.ids_)
+      {
+        from = std::lower_bound(from, std::end(larger.ids_), id);
+
+        if (from == std::end(larger.ids_))
+        {
+          break;
+        }
+
+        if (*from == id)
+        {
+          result.push_back(id);
+        }
+      }
+    } else {
+      std::set_intersection(
+        std::begin(ids_), std::end(ids_),
+        std::begin(other.ids_), std::end(other.ids_),
+        std::back_inserter(result));
+    }
+
+    result.shrink_to_fit();
+
+    return id_set(std::move(result), sorted_tag());
+  }
+
+  id_set id_set::difference(const id_set& other) const
+  {
+    std::vector<user_id> result;
+    result.reserve(size());
+
+    if (other.size() / searchRatio > size())
+    {
+      auto from = std::begin(other.ids_);
+
+      for (user_id id : ids_)
+      {
+        from = std::lower_bound(from, std::end(other.ids_), id);
+
+        if ((from == std::end(other.ids_)) || (*from != id))
+        {
+          result.push_back(id);
+        }
+      }
+    } else {
+      std::set_difference(
+        std::begin(ids_), std::end(ids_),
+        std::begin(other.ids_), std::end(other.ids_),
+        std::back_inserter(result));
+    }
+
+    result.shrink_to_fit();
+
+    return id_set(std::move(result), sorted_tag());
+  }
+
+  id_set id_set::merge(const id_set& other) const
+  {
+    std::vector<user_id> result;
+    result.reserve(size() + other.size());
+
+    std::set_union(
+      std::begin(ids_), std::end(ids_),
+      std::begin(other.ids_), std::end(other.ids_),
+      std::back_inserter(result));
+
+    result.shrink_to_fit();
+
+    return id_set(std::move(result), sorted_tag());
+  }
+
+}
@@ -0,0 +1,84 @@
+#ifndef ID_SET_H_7A3E59C2
+#define ID_SET_H_7A3E59C2
+
+#include <vector>
+#include "user.h"
+
+namespace twitter {
+
+  // An immutable set of ids stored as a sorted vector, which takes eight
+  // bytes per id instead of a tree node and allows linear-time set
+  // operations.
+  class id_set {
+  public:
+
+    using const_iterator = std::vector<user_id>::const_iterator;
+
+    id_set() = default;
+
+    // Sorts the ids and removes duplicates.
+    explicit id_set(std::vector<user_id> ids);
+
+    template <typename InputIterator>
+    id_set(InputIterator first, InputIterator last) :
+      id_set(std::vector<user_id>(first, last))
+    {
+    }
+
+    size_t size() const
+    {
+      return ids_.size();
+    }
+
+    bool empty() const
+    {
+      return ids_.empty();
+    }
+
+    const_iterator begin() const
+    {
+      return std::begin(ids_);
+    }
+
+    const_iterator end() const
+    {
+      return std::end(ids_);
+    }
+
+    const std::vector<user_id>& getIDs() const
+    {
+      return ids_;
+    }
+
+    bool contains(user_id id) const;
+
+    id_set intersection(const id_set& other) const;
+
+    id_set difference(const id_set& other) const;
+
+    id_set merge(const id_set& other) const;
+
+    bool operator==(const id_set& other) const
+    {
+      return ids_ == other.ids_;
+    }
+
+    bool operator!=(const id_set& other) const
+    {
+      return ids_ != other.ids_;
+    }
+
+  private:
+
+    struct sorted_tag {};
+
+    id_set(std::vector<user_id> ids, sorted_tag) : ids_(std::move(ids))
+    {
+    }
+
+    std::vector<user_id> ids_;
+  };
+
+}
+
+#endif /* end of include guard: ID_SET_H_7A3E59C2 */
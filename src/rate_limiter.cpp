@@ -0,0 +1,156 @@
+#include "rate_limiter.h"
+#include <algorithm>
+
+namespace twitter {
+
+  std::string rate_limiter::endpointOf(const std::string& url)
+  {
+    std::string::size_type start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    start = url.find('/', start);
+
+    if (start == std::string::npos)
+    {
+      return "";
+    }
+
+    std::string::size_type end = url.find_first_of("?#", start);
+    std::string path = url.substr(start + 1, end - start - 1);
+
+    // Skip the API version.
+    std::string::size_type slash = path.find('/');
+    if (slash != std::string::npos)
+    {
+      path.erase(0, slash + 1);
+    }
+
+    static const std::string extension = ".json";
+    if ((path.size() > extension.size()) &&
+      (path.compare(path.size() - extension.size(), extension.size(), extension) == 0))
+    {
+      path.erase(path.size() - extension.size());
+    }
+
+    return path;
+  }
+
+  long rate_limiter::defaultLimit(const std::string& endpoint)
+  {
+    static const std::map<std::string, long> limits = {
+      {"statuses/lookup", 900},
+      {"users/lookup", 900},
+      {"statuses/mentions_timeline", 75},
+      {"account/verify_credentials", 75},
+      {"statuses/home_timeline", 15},
+      {"friends/ids", 15},
+      {"followers/ids", 15},
+      {"blocks/ids", 15}
+    };
+
+    auto it = limits.find(endpoint);
+    if (it == std::end(limits))
+    {
+      return 15;
+    }
+
+    return it->second;
+  }
+
+  bool rate_limiter::tryAcquire(
+    const std::string& endpoint,
+    clock::time_point& retryAt)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = windows_.find(endpoint);
+    if (it == std::end(windows_))
+    {
+      return true;
+    }
+
+    window& w = it->second;
+
+    if (clock::now() >= w.reset)
+    {
+      // The window has rolled over; the next response will tell us when the
+      // new one ends.
+      w.remaining = w.limit;
+      w.reset = clock::time_point::max();
+    }
+
+    if (w.remaining > 0)
+    {
+      w.remaining--;
+
+      return true;
+    }
+
+    if (w.reset == clock::time_point::max())
+    {
+      // We don't know when the new window ends yet, so check again soon.
+      retryAt = clock::now() + std::chrono::seconds(60);
+    } else {
+      retryAt = w.reset;
+    }
+
+    return false;
+  }
+
+  void rate_limiter::update(
+    const std::string& endpoint,
+    const std::map<std::string, std::string>& headers)
+  {
+    auto limit = headers.find("x-rate-limit-limit");
+    auto remaining = headers.find("x-rate-limit-remaining");
+    auto reset = headers.find("x-rate-limit-reset");
+
+    if ((limit == std::end(headers)) ||
+      (remaining == std::end(headers)) ||
+      (reset == std::end(headers)))
+    {
+      return;
+    }
+
+    window latest;
+
+    try
+    {
+      latest.limit = std::stol(limit->second);
+      latest.remaining = std::stol(remaining->second);
+      latest.reset = clock::from_time_t(std::stol(reset->second));
+    } catch (const std::logic_error& error)
+    {
+      // Ignore headers we can't make sense of.
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = windows_.find(endpoint);
+    if ((it == std::end(windows_)) || (it->second.reset != latest.reset))
+    {
+      windows_[endpoint] = latest;
+    } else {
+      // Responses to concurrent calls can arrive out of order, and calls that
+      // are still in flight have already been taken off locally.
+      it->second.limit = latest.limit;
+      it->second.remaining = std::min(it->second.remaining, latest.remaining);
+    }
+  }
+
+  bool rate_limiter::getWindow(const std::string& endpoint, window& result) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = windows_.find(endpoint);
+    if (it == std::end(windows_))
+    {
+      return false;
+    }
+
+    result = it->second;
+
+    return true;
+  }
+
+}
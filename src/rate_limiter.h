@@ -0,0 +1,82 @@
+#ifndef RATE_LIMITER_H_2F6C8A31
+#define RATE_LIMITER_H_2F6C8A31
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace twitter {
+
+  // What to do with a call to an endpoint whose rate limit window is used up.
+  enum class rate_policy {
+    // The call waits until the window resets. A synchronous call sleeps on
+    // the calling thread, and an asynchronous one is sent by the engine once
+    // the window resets, without tying up a thread.
+    block,
+
+    // The call throws rate_limit_exceeded without contacting Twitter.
+    fail
+  };
+
+  // Tracks the x-rate-limit-* headers Twitter sends back for each endpoint
+  // and hands out the remaining calls in each window.
+  class rate_limiter {
+  public:
+
+    using clock = std::chrono::system_clock;
+
+    struct window {
+      long limit;
+      long remaining;
+      clock::time_point reset;
+    };
+
+    explicit rate_limiter(rate_policy policy = rate_policy::block) :
+      policy_(policy)
+    {
+    }
+
+    // Maps a request URL to the endpoint its limit is counted against, e.g.
+    // "followers/ids".
+    static std::string endpointOf(const std::string& url);
+
+    // The number of calls per fifteen minute window that Twitter documents
+    // for the endpoint, for use before any of its headers have been seen.
+    static long defaultLimit(const std::string& endpoint);
+
+    // Takes one call from the endpoint's window. If none are left, returns
+    // false and sets retryAt to when the window resets. Endpoints that have
+    // not been seen yet are never limited.
+    bool tryAcquire(const std::string& endpoint, clock::time_point& retryAt);
+
+    // Records the headers of a response from the endpoint.
+    void update(
+      const std::string& endpoint,
+      const std::map<std::string, std::string>& headers);
+
+    // Returns false if nothing is known about the endpoint yet.
+    bool getWindow(const std::string& endpoint, window& result) const;
+
+    rate_policy getPolicy() const
+    {
+      return policy_;
+    }
+
+    void setPolicy(rate_policy policy)
+    {
+      policy_ = policy;
+    }
+
+  private:
+
+    std::atomic<rate_policy> policy_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, window> windows_;
+  };
+
+}
+
+#endif /* end of include guard: RATE_LIMITER_H_2F6C8A31 */
@@ -1,4 +1,8 @@
 #include "request.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <thread>
 #include <json.hpp>
 #include "codes.h"
 
@@ -77,28 +81,90 @@ int my_trace(CURL *handle, curl_infotype type,
 namespace twitter {
 
   request::request(
-    std::string url) try :
-      ios_(output_),
-      conn_(ios_)
-  {
-    conn_.add<CURLOPT_URL>(url.c_str());
-  } catch (const curl::curl_easy_exception& error)
+    std::string url,
+    connection_pool* pool,
+    rate_limiter* limiter) :
+      url_(std::move(url)),
+      pool_(pool),
+      limiter_(limiter)
   {
-    std::throw_with_nested(connection_error());
+    if (limiter_)
+    {
+      endpoint_ = rate_limiter::endpointOf(url_);
+    }
   }
 
   std::string request::perform()
   {
+    if (limiter_)
+    {
+      rate_limiter::clock::time_point retryAt;
+
+      while (!limiter_->tryAcquire(endpoint_, retryAt))
+      {
+        if (limiter_->getPolicy() == rate_policy::fail)
+        {
+          throw rate_limit_exceeded("Rate limit window for " + endpoint_ + " is used up");
+        }
+
+        std::this_thread::sleep_until(retryAt);
+      }
+    }
+
+    open();
+
     try
     {
-      conn_.perform();
+      conn().perform();
     } catch (const curl::curl_easy_exception& error)
     {
       std::throw_with_nested(connection_error());
     }
 
-    int response_code = conn_.get_info<CURLINFO_RESPONSE_CODE>().get();
-    std::string result = output_.str();
+    return complete();
+  }
+
+  void request::open()
+  {
+    try
+    {
+      lease_.reset(new connection_pool::lease(
+        pool_ ? pool_->acquire(url_) : connection_pool::lease()));
+
+      if (pool_)
+      {
+        body_ = pool_->takeBuffer();
+      }
+
+      CURL* handle = conn().get_curl();
+
+      curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, &request::writeHeader);
+      curl_easy_setopt(handle, CURLOPT_HEADERDATA, static_cast<void*>(this));
+
+      curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &request::writeBody);
+      curl_easy_setopt(handle, CURLOPT_WRITEDATA, static_cast<void*>(this));
+      conn().add<CURLOPT_TCP_KEEPALIVE>(1L);
+      conn().add<CURLOPT_URL>(url_.c_str());
+
+      configure(conn(), url_);
+    } catch (const std::invalid_argument& error)
+    {
+      std::throw_with_nested(connection_error());
+    } catch (const curl::curl_easy_exception& error)
+    {
+      std::throw_with_nested(connection_error());
+    }
+  }
+
+  std::string request::complete()
+  {
+    if (limiter_)
+    {
+      limiter_->update(endpoint_, responseHeaders_);
+    }
+
+    int response_code = conn().get_info<CURLINFO_RESPONSE_CODE>().get();
+    const std::string& result = body_;
 
     if (response_code / 100 != 2)
     {
@@ -188,77 +254,150 @@ namespace twitter {
       throw unknown_error(response_code, result);
     }
 
-    return result;
+    return std::move(body_);
+  }
+
+  size_t request::writeBody(
+    char* data,
+    size_t size,
+    size_t nmemb,
+    void* userdata)
+  {
+    request* self = static_cast<request*>(userdata);
+    size_t length = size * nmemb;
+
+    self->body_.append(data, length);
+
+    return length;
+  }
+
+  size_t request::writeHeader(
+    char* data,
+    size_t size,
+    size_t nitems,
+    void* userdata)
+  {
+    request* self = static_cast<request*>(userdata);
+    size_t length = size * nitems;
+    std::string line(data, length);
+
+    std::string::size_type colon = line.find(':');
+    if (colon == std::string::npos)
+    {
+      // A new status line means any headers so far belonged to an interim
+      // response, like 100 Continue.
+      if (line.compare(0, 5, "HTTP/") == 0)
+      {
+        self->responseHeaders_.clear();
+      }
+
+      return length;
+    }
+
+    std::string name = line.substr(0, colon);
+    std::transform(std::begin(name), std::end(name), std::begin(name), [] (char c) {
+      return std::tolower(static_cast<unsigned char>(c));
+    });
+
+    std::string::size_type valueStart = line.find_first_not_of(" \t", colon + 1);
+    std::string::size_type valueEnd = line.find_last_not_of(" \t\r\n");
+
+    std::string value;
+    if ((valueStart != std::string::npos) && (valueEnd >= valueStart))
+    {
+      value = line.substr(valueStart, valueEnd - valueStart + 1);
+    }
+
+    if (name == "content-length")
+    {
+      // Size the body buffer up front so it is filled without reallocating,
+      // within reason in case the header is bogus.
+      unsigned long long expected = std::strtoull(value.c_str(), nullptr, 10);
+
+      if (expected <= maxPresize)
+      {
+        self->body_.reserve(self->body_.size() + expected);
+      }
+    }
+
+    self->responseHeaders_[name] = std::move(value);
+
+    return length;
   }
 
   get::get(
     const auth& tauth,
-    std::string url) try :
-      request(url)
+    std::string url,
+    connection_pool* pool,
+    rate_limiter* limiter) :
+      request(std::move(url), pool, limiter),
+      auth_(tauth)
+  {
+  }
+
+  void get::configure(curl::curl_easy& conn, const std::string& url)
   {
     std::string oauthHeader =
-      tauth.getClient().getFormattedHttpHeader(OAuth::Http::Get, url, "");
+      auth_.getSigner().getAuthorizationHeader("GET", url, "");
 
     if (!oauthHeader.empty())
     {
       headers_.add(std::move(oauthHeader));
     }
 
-    conn_.add<CURLOPT_HTTPHEADER>(headers_.get());
-  } catch (const OAuth::ParseError& error)
-  {
-    std::throw_with_nested(connection_error());
-  } catch (const curl::curl_easy_exception& error)
-  {
-    std::throw_with_nested(connection_error());
+    conn.add<CURLOPT_HTTPHEADER>(headers_.get());
   }
 
   post::post(
     const auth& tauth,
     std::string url,
-    std::string datastr) try :
-      request(url)
+    std::string datastr,
+    connection_pool* pool,
+    rate_limiter* limiter) :
+      request(std::move(url), pool, limiter),
+      auth_(tauth),
+      datastr_(std::move(datastr))
+  {
+  }
+
+  void post::configure(curl::curl_easy& conn, const std::string& url)
   {
     std::string oauthHeader =
-      tauth.getClient().getFormattedHttpHeader(OAuth::Http::Post, url, datastr);
+      auth_.getSigner().getAuthorizationHeader("POST", url, datastr_);
 
     if (!oauthHeader.empty())
     {
       headers_.add(std::move(oauthHeader));
     }
 
-    conn_.add<CURLOPT_HTTPHEADER>(headers_.get());
-    conn_.add<CURLOPT_COPYPOSTFIELDS>(datastr.c_str());
-  } catch (const OAuth::ParseError& error)
-  {
-    std::throw_with_nested(connection_error());
-  } catch (const curl::curl_easy_exception& error)
-  {
-    std::throw_with_nested(connection_error());
+    conn.add<CURLOPT_HTTPHEADER>(headers_.get());
+    conn.add<CURLOPT_COPYPOSTFIELDS>(datastr_.c_str());
   }
 
   multipost::multipost(
     const auth& tauth,
     std::string url,
-    const curl_httppost* fields) try :
-      request(url)
+    const curl_httppost* fields,
+    connection_pool* pool,
+    rate_limiter* limiter) :
+      request(std::move(url), pool, limiter),
+      auth_(tauth),
+      fields_(fields)
+  {
+  }
+
+  void multipost::configure(curl::curl_easy& conn, const std::string& url)
   {
     std::string oauthHeader =
-      tauth.getClient().getFormattedHttpHeader(OAuth::Http::Post, url, "");
+      auth_.getSigner().getAuthorizationHeader("POST", url, "");
 
     if (!oauthHeader.empty())
     {
       headers_.add(std::move(oauthHeader));
     }
 
-    conn_.add<CURLOPT_HTTPHEADER>(headers_.get());
-    conn_.add<CURLOPT_HTTPPOST>(fields);
-  } catch (const OAuth::ParseError& error)
-  {
-    std::throw_with_nested(connection_error());
-  } catch (const curl::curl_easy_exception& error)
-  {
-    std::throw_with_nested(connection_error());
+    conn.add<CURLOPT_HTTPHEADER>(headers_.get());
+    conn.add<CURLOPT_HTTPPOST>(fields_);
   }
 
 }
@@ -1,30 +1,86 @@
 #ifndef REQUEST_H_9D3C30E2
 #define REQUEST_H_9D3C30E2
 
+#include <map>
+#include <memory>
 #include <string>
-#include <sstream>
 #include <curl_easy.h>
 #include <curl_header.h>
 #include "auth.h"
+#include "connection_pool.h"
+#include "rate_limiter.h"
 
 namespace twitter {
 
+  class engine;
+
   class request
   {
   public:
 
-    explicit request(std::string url);
+    request(
+      std::string url,
+      connection_pool* pool,
+      rate_limiter* limiter);
+
+    virtual ~request() = default;
 
+    // Waits for the rate limit window, if the limiter's policy is to block,
+    // before a connection is taken from the pool.
     std::string perform();
 
-  private:
+    const std::string& getUrl() const
+    {
+      return url_;
+    }
 
-    std::ostringstream output_;
-    curl::curl_ios<std::ostringstream> ios_;
+    const std::map<std::string, std::string>& getResponseHeaders() const
+    {
+      return responseHeaders_;
+    }
 
   protected:
 
-    curl::curl_easy conn_;
+    // Sets the method, headers and body on a freshly leased handle. This is
+    // only done once the request is about to be sent, so that a request
+    // that waits for its rate limit window holds no connection and is not
+    // signed with a stale timestamp.
+    virtual void configure(curl::curl_easy& conn, const std::string& url) = 0;
+
+  private:
+
+    friend class engine;
+
+    void open();
+
+    curl::curl_easy& conn() const
+    {
+      return lease_->get();
+    }
+
+    std::string complete();
+
+    static size_t writeHeader(
+      char* data,
+      size_t size,
+      size_t nitems,
+      void* userdata);
+
+    static size_t writeBody(
+      char* data,
+      size_t size,
+      size_t nmemb,
+      void* userdata);
+
+    static const unsigned long long maxPresize = 64 * 1024 * 1024;
+
+    std::string url_;
+    connection_pool* pool_;
+    std::unique_ptr<connection_pool::lease> lease_;
+    std::string body_;
+    rate_limiter* limiter_;
+    std::string endpoint_;
+    std::map<std::string, std::string> responseHeaders_;
   };
 
   class get : public request
@@ -33,10 +89,17 @@ namespace twitter {
 
     get(
       const auth& tauth,
-      std::string url);
+      std::string url,
+      connection_pool* pool = nullptr,
+      rate_limiter* limiter = nullptr);
+
+  protected:
+
+    void configure(curl::curl_easy& conn, const std::string& url) override;
 
   private:
 
+    const auth& auth_;
     curl::curl_header headers_;
   };
 
@@ -47,10 +110,18 @@ namespace twitter {
     post(
       const auth& tauth,
       std::string url,
-      std::string datastr);
+      std::string datastr,
+      connection_pool* pool = nullptr,
+      rate_limiter* limiter = nullptr);
+
+  protected:
+
+    void configure(curl::curl_easy& conn, const std::string& url) override;
 
   private:
 
+    const auth& auth_;
+    std::string datastr_;
     curl::curl_header headers_;
   };
 
@@ -61,10 +132,18 @@ namespace twitter {
     multipost(
       const auth& tauth,
       std::string url,
-      const curl_httppost* fields);
+      const curl_httppost* fields,
+      connection_pool* pool = nullptr,
+      rate_limiter* limiter = nullptr);
+
+  protected:
+
+    void configure(curl::curl_easy& conn, const std::string& url) override;
 
   private:
 
+    const auth& auth_;
+    const curl_httppost* fields_;
     curl::curl_header headers_;
   };
 
@@ -0,0 +1,79 @@
+#include "retry_policy.h"
+#include <algorithm>
+#include <random>
+#include "codes.h"
+
+namespace twitter {
+
+  retry_policy::retry_policy() :
+    maxAttempts_(4),
+    initialDelay_(1000),
+    maxDelay_(30000),
+    jitter_(0.5),
+    deadline_(120000)
+  {
+    retryOn<connection_error>();
+    retryOn<server_error>();
+    retryOn<server_unavailable>();
+    retryOn<server_overloaded>();
+    retryOn<server_timeout>();
+  }
+
+  retry_policy retry_policy::none()
+  {
+    retry_policy result;
+    result.setMaxAttempts(1);
+
+    return result;
+  }
+
+  bool retry_policy::shouldRetry(
+    std::exception_ptr error,
+    size_t attempt,
+    clock::time_point start,
+    std::chrono::milliseconds& delay) const
+  {
+    if (attempt >= maxAttempts_)
+    {
+      return false;
+    }
+
+    auto applies = std::find_if(std::rbegin(rules_), std::rend(rules_),
+      [&] (const rule& r) {
+        return r.matches(error);
+      });
+
+    if ((applies == std::rend(rules_)) || !applies->retry)
+    {
+      return false;
+    }
+
+    double backoff = initialDelay_.count();
+    for (size_t i = 1; (i < attempt) && (backoff < maxDelay_.count()); i++)
+    {
+      backoff *= 2;
+    }
+
+    if (backoff > maxDelay_.count())
+    {
+      backoff = maxDelay_.count();
+    }
+
+    if (jitter_ > 0)
+    {
+      static thread_local std::mt19937 rng(std::random_device{}());
+      std::uniform_real_distribution<double> fraction(0.0, jitter_);
+      backoff *= 1.0 - fraction(rng);
+    }
+
+    delay = std::chrono::milliseconds(static_cast<long long>(backoff));
+
+    if ((deadline_.count() > 0) && (clock::now() + delay - start > deadline_))
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+}
@@ -0,0 +1,151 @@
+#ifndef RETRY_POLICY_H_D17A4C08
+#define RETRY_POLICY_H_D17A4C08
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace twitter {
+
+  // Decides whether and when a failed call is tried again. Delays grow
+  // exponentially from the initial delay up to the maximum, and are then
+  // shortened by a random fraction of up to the jitter so that many clients
+  // don't retry in lockstep.
+  //
+  // A rule applies to exceptions of its type and of any type derived from
+  // it, including ones thrown through std::throw_with_nested, and the most
+  // recently added rule that applies decides. By default connection errors
+  // and Twitter's transient server errors are retried.
+  class retry_policy {
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    retry_policy();
+
+    static retry_policy none();
+
+    size_t getMaxAttempts() const
+    {
+      return maxAttempts_;
+    }
+
+    retry_policy& setMaxAttempts(size_t maxAttempts)
+    {
+      maxAttempts_ = maxAttempts;
+
+      return *this;
+    }
+
+    retry_policy& setInitialDelay(std::chrono::milliseconds delay)
+    {
+      initialDelay_ = delay;
+
+      return *this;
+    }
+
+    retry_policy& setMaxDelay(std::chrono::milliseconds delay)
+    {
+      maxDelay_ = delay;
+
+      return *this;
+    }
+
+    // The largest fraction a delay is shortened by. Throws
+    // std::invalid_argument unless it is between zero and one.
+    retry_policy& setJitter(double jitter)
+    {
+      if (!((jitter >= 0.0) && (jitter <= 1.0)))
+      {
+        throw std::invalid_argument("jitter must be between 0 and 1");
+      }
+
+      jitter_ = jitter;
+
+      return *this;
+    }
+
+    // The total time, measured from the first attempt, after which no more
+    // retries are started. Zero means no deadline.
+    retry_policy& setDeadline(std::chrono::milliseconds deadline)
+    {
+      deadline_ = deadline;
+
+      return *this;
+    }
+
+    template <typename Error>
+    retry_policy& retryOn(bool retry = true)
+    {
+      rules_.push_back({
+        [] (std::exception_ptr error) {
+          try
+          {
+            std::rethrow_exception(error);
+          } catch (const Error&)
+          {
+            return true;
+          } catch (...)
+          {
+            return false;
+          }
+        },
+        retry});
+
+      return *this;
+    }
+
+    // Decides whether a call that failed with the given error on the given
+    // attempt (counting from one) should be tried again, and if so how long
+    // to wait before doing so.
+    bool shouldRetry(
+      std::exception_ptr error,
+      size_t attempt,
+      clock::time_point start,
+      std::chrono::milliseconds& delay) const;
+
+    template <typename Function>
+    auto run(Function&& fn) const -> decltype(fn())
+    {
+      clock::time_point start = clock::now();
+
+      for (size_t attempt = 1;; attempt++)
+      {
+        try
+        {
+          return fn();
+        } catch (...)
+        {
+          std::chrono::milliseconds delay;
+
+          if (!shouldRetry(std::current_exception(), attempt, start, delay))
+          {
+            throw;
+          }
+
+          std::this_thread::sleep_for(delay);
+        }
+      }
+    }
+
+  private:
+
+    struct rule {
+      std::function<bool(std::exception_ptr)> matches;
+      bool retry;
+    };
+
+    size_t maxAttempts_;
+    std::chrono::milliseconds initialDelay_;
+    std::chrono::milliseconds maxDelay_;
+    double jitter_;
+    std::chrono::milliseconds deadline_;
+    std::vector<rule> rules_;
+  };
+
+}
+
+#endif /* end of include guard: RETRY_POLICY_H_D17A4C08 */
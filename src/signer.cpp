@@ -0,0 +1,461 @@
+#include "signer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace twitter {
+
+  static const char hexDigits[] = "0123456789ABCDEF";
+
+  static uint32_t rotl(uint32_t value, int bits)
+  {
+    return (value << bits) | (value >> (32 - bits));
+  }
+
+  static std::string base64Encode(const unsigned char* data, size_t length)
+  {
+    static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string result;
+    result.reserve((length + 2) / 3 * 4);
+
+    for (size_t i = 0; i < length; i += 3)
+    {
+      uint32_t group = data[i] << 16;
+
+      if (i + 1 < length)
+      {
+        group |= data[i + 1] << 8;
+      }
+
+      if (i + 2 < length)
+      {
+        group |= data[i + 2];
+      }
+
+      result.push_back(alphabet[(group >> 18) & 0x3F]);
+      result.push_back(alphabet[(group >> 12) & 0x3F]);
+      result.push_back((i + 1 < length) ? alphabet[(group >> 6) & 0x3F] : '=');
+      result.push_back((i + 2 < length) ? alphabet[group & 0x3F] : '=');
+    }
+
+    return result;
+  }
+
+  std::string percentEncode(const std::string& input)
+  {
+    std::string result;
+    result.reserve(input.size() * 3 / 2);
+
+    for (char c : input)
+    {
+      unsigned char u = static_cast<unsigned char>(c);
+
+      if (std::isalnum(u) || (c == '-') || (c == '.') || (c == '_') || (c == '~'))
+      {
+        result.push_back(c);
+      } else {
+        result.push_back('%');
+        result.push_back(hexDigits[u >> 4]);
+        result.push_back(hexDigits[u & 0x0F]);
+      }
+    }
+
+    return result;
+  }
+
+  std::string percentDecode(const char* begin, const char* end)
+  {
+    auto hexValue = [] (char h) -> int {
+      if ((h >= '0') && (h <= '9'))
+      {
+        return h - '0';
+      } else if ((h >= 'a') && (h <= 'f'))
+      {
+        return h - 'a' + 10;
+      } else if ((h >= 'A') && (h <= 'F'))
+      {
+        return h - 'A' + 10;
+      } else {
+        return -1;
+      }
+    };
+
+    std::string result;
+    result.reserve(end - begin);
+
+    for (const char* cur = begin; cur != end; cur++)
+    {
+      if (*cur == '+')
+      {
+        result.push_back(' ');
+      } else if ((*cur == '%') && (end - cur >= 3)
+        && (hexValue(cur[1]) >= 0) && (hexValue(cur[2]) >= 0))
+      {
+        result.push_back(static_cast<char>(
+          (hexValue(cur[1]) << 4) | hexValue(cur[2])));
+
+        cur += 2;
+      } else {
+        result.push_back(*cur);
+      }
+    }
+
+    return result;
+  }
+
+  signer::signer(
+    const std::string& consumerKey,
+    const std::string& consumerSecret,
+    const std::string& accessKey,
+    const std::string& accessSecret) :
+      consumerKey_(percentEncode(consumerKey)),
+      token_(percentEncode(accessKey))
+  {
+    std::string key = percentEncode(consumerSecret) + "&" + percentEncode(accessSecret);
+    unsigned char block[64] = {0};
+
+    if (key.size() > sizeof(block))
+    {
+      sha1_state hashed;
+      sha1Init(hashed);
+      sha1Update(hashed, key.data(), key.size());
+      sha1Final(hashed, block);
+    } else {
+      std::memcpy(block, key.data(), key.size());
+    }
+
+    unsigned char pad[64];
+
+    for (size_t i = 0; i < sizeof(pad); i++)
+    {
+      pad[i] = block[i] ^ 0x36;
+    }
+
+    sha1Init(inner_);
+    sha1Update(inner_, reinterpret_cast<const char*>(pad), sizeof(pad));
+
+    for (size_t i = 0; i < sizeof(pad); i++)
+    {
+      pad[i] = block[i] ^ 0x5C;
+    }
+
+    sha1Init(outer_);
+    sha1Update(outer_, reinterpret_cast<const char*>(pad), sizeof(pad));
+  }
+
+  std::string signer::getAuthorizationHeader(
+    const char* method,
+    const std::string& url,
+    const std::string& body) const
+  {
+    return getAuthorizationHeader(method, url, body, makeNonce(), std::time(nullptr));
+  }
+
+  std::string signer::getAuthorizationHeader(
+    const char* method,
+    const std::string& url,
+    const std::string& body,
+    const std::string& nonce,
+    time_t timestamp) const
+  {
+    std::string::size_type schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos)
+    {
+      throw std::invalid_argument("URL has no scheme: " + url);
+    }
+
+    std::string::size_type hostEnd = url.find_first_of("/?#", schemeEnd + 3);
+    std::string::size_type pathEnd = url.find_first_of("?#", schemeEnd + 3);
+
+    std::string scheme = url.substr(0, schemeEnd);
+    std::string host = url.substr(schemeEnd + 3, hostEnd - (schemeEnd + 3));
+    std::transform(std::begin(scheme), std::end(scheme), std::begin(scheme), ::tolower);
+    std::transform(std::begin(host), std::end(host), std::begin(host), ::tolower);
+
+    if (host.empty())
+    {
+      throw std::invalid_argument("URL has no host: " + url);
+    }
+
+    std::string::size_type portStart = host.rfind(':');
+    if (portStart != std::string::npos)
+    {
+      std::string port = host.substr(portStart + 1);
+
+      if (((scheme == "http") && (port == "80")) ||
+        ((scheme == "https") && (port == "443")))
+      {
+        host.erase(portStart);
+      }
+    }
+
+    std::string baseUrl = scheme + "://" + host;
+
+    if ((hostEnd == std::string::npos) || (url[hostEnd] != '/'))
+    {
+      baseUrl.push_back('/');
+    } else {
+      baseUrl.append(url, hostEnd, pathEnd - hostEnd);
+    }
+
+    std::vector<parameter> params;
+
+    if ((pathEnd != std::string::npos) && (url[pathEnd] == '?'))
+    {
+      std::string::size_type queryEnd = url.find('#', pathEnd);
+      if (queryEnd == std::string::npos)
+      {
+        queryEnd = url.size();
+      }
+
+      addParameters(params, url.data() + pathEnd + 1, url.data() + queryEnd);
+    }
+
+    addParameters(params, body.data(), body.data() + body.size());
+    std::sort(std::begin(params), std::end(params));
+
+    std::string str_timestamp = std::to_string(timestamp);
+
+    // Already in order.
+    std::vector<parameter> oauthParams = {
+      {"oauth_consumer_key", consumerKey_},
+      {"oauth_nonce", nonce},
+      {"oauth_signature_method", "HMAC-SHA1"},
+      {"oauth_timestamp", str_timestamp},
+      {"oauth_token", token_},
+      {"oauth_version", "1.0"}};
+
+    std::vector<parameter> merged;
+    merged.reserve(params.size() + oauthParams.size());
+
+    std::merge(
+      std::begin(params), std::end(params),
+      std::begin(oauthParams), std::end(oauthParams),
+      std::back_inserter(merged));
+
+    std::string paramString;
+
+    for (const parameter& param : merged)
+    {
+      if (!paramString.empty())
+      {
+        paramString.push_back('&');
+      }
+
+      paramString.append(param.first);
+      paramString.push_back('=');
+      paramString.append(param.second);
+    }
+
+    std::string baseString = method;
+    baseString.push_back('&');
+    baseString.append(percentEncode(baseUrl));
+    baseString.push_back('&');
+    baseString.append(percentEncode(paramString));
+
+    oauthParams.insert(
+      std::begin(oauthParams) + 2,
+      {"oauth_signature", percentEncode(sign(baseString))});
+
+    std::string result = "Authorization: OAuth ";
+
+    for (const parameter& param : oauthParams)
+    {
+      if (param.first != "oauth_consumer_key")
+      {
+        result.push_back(',');
+      }
+
+      result.append(param.first);
+      result.append("=\"");
+      result.append(param.second);
+      result.push_back('"');
+    }
+
+    return result;
+  }
+
+  std::string signer::sign(const std::string& baseString) const
+  {
+    unsigned char digest[20];
+
+    sha1_state inner = inner_;
+    sha1Update(inner, baseString.data(), baseString.size());
+    sha1Final(inner, digest);
+
+    sha1_state outer = outer_;
+    sha1Update(outer, reinterpret_cast<const char*>(digest), sizeof(digest));
+    sha1Final(outer, digest);
+
+    return base64Encode(digest, sizeof(digest));
+  }
+
+  void signer::sha1Init(sha1_state& state)
+  {
+    state.h[0] = 0x67452301;
+    state.h[1] = 0xEFCDAB89;
+    state.h[2] = 0x98BADCFE;
+    state.h[3] = 0x10325476;
+    state.h[4] = 0xC3D2E1F0;
+    state.length = 0;
+    state.buffered = 0;
+  }
+
+  void signer::sha1Update(sha1_state& state, const char* data, size_t length)
+  {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    state.length += length;
+
+    if (state.buffered > 0)
+    {
+      size_t take = std::min(length, sizeof(state.buffer) - state.buffered);
+      std::memcpy(state.buffer + state.buffered, bytes, take);
+      state.buffered += take;
+      bytes += take;
+      length -= take;
+
+      if (state.buffered < sizeof(state.buffer))
+      {
+        return;
+      }
+
+      sha1Block(state.h, state.buffer);
+      state.buffered = 0;
+    }
+
+    for (; length >= 64; bytes += 64, length -= 64)
+    {
+      sha1Block(state.h, bytes);
+    }
+
+    std::memcpy(state.buffer, bytes, length);
+    state.buffered = length;
+  }
+
+  void signer::sha1Final(sha1_state& state, unsigned char digest[20])
+  {
+    uint64_t bits = state.length * 8;
+    unsigned char padding[72] = {0x80};
+    size_t padLength = (state.buffered < 56) ? (56 - state.buffered) : (120 - state.buffered);
+
+    for (int i = 0; i < 8; i++)
+    {
+      padding[padLength + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+    }
+
+    sha1Update(state, reinterpret_cast<const char*>(padding), padLength + 8);
+
+    for (int i = 0; i < 20; i++)
+    {
+      digest[i] = static_cast<unsigned char>(state.h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+  }
+
+  void signer::sha1Block(uint32_t h[5], const unsigned char block[64])
+  {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++)
+    {
+      w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16)
+        | (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+    }
+
+    for (int i = 16; i < 80; i++)
+    {
+      w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = h[0];
+    uint32_t b = h[1];
+    uint32_t c = h[2];
+    uint32_t d = h[3];
+    uint32_t e = h[4];
+
+    for (int i = 0; i < 80; i++)
+    {
+      uint32_t f;
+      uint32_t k;
+
+      if (i < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+
+      uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = temp;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  void signer::addParameters(
+    std::vector<parameter>& params,
+    const char* begin,
+    const char* end)
+  {
+    while (begin < end)
+    {
+      const char* pairEnd = std::find(begin, end, '&');
+      const char* equals = std::find(begin, pairEnd, '=');
+
+      if (pairEnd != begin)
+      {
+        // Decoding and encoding again gives the one canonical encoding the
+        // signature needs, whatever the caller's encoder chose to escape.
+        params.emplace_back(
+          percentEncode(percentDecode(begin, equals)),
+          percentEncode(percentDecode(
+            (equals == pairEnd) ? pairEnd : equals + 1, pairEnd)));
+      }
+
+      begin = (pairEnd == end) ? end : pairEnd + 1;
+    }
+  }
+
+  std::string signer::makeNonce()
+  {
+    thread_local std::mt19937_64 rng {std::random_device()()};
+
+    std::string result;
+    result.reserve(32);
+
+    for (int i = 0; i < 2; i++)
+    {
+      uint64_t bits = rng();
+
+      for (int j = 0; j < 16; j++)
+      {
+        result.push_back(hexDigits[(bits >> (4 * j)) & 0x0F]);
+      }
+    }
+
+    return result;
+  }
+
+};
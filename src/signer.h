@@ -0,0 +1,84 @@
+#ifndef SIGNER_H_92C4E1B7
+#define SIGNER_H_92C4E1B7
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace twitter {
+
+  // Signs requests with OAuth 1.0a HMAC-SHA1. Everything that is the same
+  // for every request is worked out once: the HMAC key is absorbed into
+  // saved inner and outer hash states, and the oauth_* parameters are kept
+  // percent-encoded and in order, so signing a request only has to encode
+  // and sort its own parameters and hash the base string.
+  //
+  // Parameters in the URL's query and in a form-encoded body are expected to
+  // be percent-encoded already, as they would be on the wire.
+  class signer {
+  public:
+
+    signer(
+      const std::string& consumerKey,
+      const std::string& consumerSecret,
+      const std::string& accessKey,
+      const std::string& accessSecret);
+
+    // Returns a complete Authorization header line. Throws
+    // std::invalid_argument if the URL can't be parsed.
+    std::string getAuthorizationHeader(
+      const char* method,
+      const std::string& url,
+      const std::string& body) const;
+
+  private:
+
+    struct sha1_state {
+      uint32_t h[5];
+      uint64_t length;
+      unsigned char buffer[64];
+      size_t buffered;
+    };
+
+    using parameter = std::pair<std::string, std::string>;
+
+    std::string getAuthorizationHeader(
+      const char* method,
+      const std::string& url,
+      const std::string& body,
+      const std::string& nonce,
+      time_t timestamp) const;
+
+    std::string sign(const std::string& baseString) const;
+
+    static void sha1Init(sha1_state& state);
+
+    static void sha1Update(sha1_state& state, const char* data, size_t length);
+
+    static void sha1Final(sha1_state& state, unsigned char digest[20]);
+
+    static void sha1Block(uint32_t h[5], const unsigned char block[64]);
+
+    static void addParameters(
+      std::vector<parameter>& params,
+      const char* begin,
+      const char* end);
+
+    static std::string makeNonce();
+
+    sha1_state inner_;
+    sha1_state outer_;
+
+    std::string consumerKey_;
+    std::string token_;
+  };
+
+  std::string percentEncode(const std::string& input);
+
+  std::string percentDecode(const char* begin, const char* end);
+
+};
+
+#endif /* end of include guard: SIGNER_H_92C4E1B7 */
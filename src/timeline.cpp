@@ -1,65 +1,290 @@
 #include "timeline.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <sstream>
-#include <json.hpp>
 #include <hkutil/string.h>
 #include "codes.h"
 #include "request.h"
+#include "decoder.h"
+#include "retry_policy.h"
+#include "client.h"
 
 namespace twitter {
 
+  // Backfill pages are spaced out so that they never crowd out polls.
+  static const std::chrono::seconds backfillDelay(5);
+
+  // Calls in a rate limit window that backfilling leaves to polls.
+  static const long backfillReserve = 2;
+
+  // Shared with the engine callbacks of a backfill, which may outlive the
+  // timeline while they wait on a timer or a rate limit window. Once it is
+  // stopped they return without touching the timeline, so the destructor
+  // only waits for one that is busy with it.
+  struct timeline::backfill_state {
+    std::mutex mutex;
+    std::condition_variable idle;
+    bool enabled = false;
+    bool running = false;
+    size_t busy = 0;
+    bool stopped = false;
+    std::deque<gap> gaps;
+    std::list<tweet> found;
+  };
+
   timeline::timeline(
     const auth& tauth,
     std::string url) :
       auth_(tauth),
-      url_(std::move(url))
+      url_(std::move(url)),
+      backfill_(std::make_shared<backfill_state>())
   {
   }
 
-  std::list<tweet> timeline::poll()
+  timeline::timeline(
+    const client& tclient,
+    std::string url) :
+      auth_(tclient.getAuth()),
+      client_(&tclient),
+      url_(std::move(url)),
+      backfill_(std::make_shared<backfill_state>())
   {
-    tweet_id maxId;
-    std::list<tweet> result;
+  }
+
+  timeline::~timeline()
+  {
+    std::unique_lock<std::mutex> lock(backfill_->mutex);
+
+    backfill_->stopped = true;
+    backfill_->idle.wait(lock, [this] () {
+      return backfill_->busy == 0;
+    });
+  }
+
+  static bool isSpace(char c)
+  {
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+  }
 
-    for (int i = 0; i < 5; i++)
+  // Finds the id of the last tweet in a page without decoding the rest of
+  // the page. The last tweet is found by walking back from the end of the
+  // page, so only it is looked at twice. A quote preceded by an even number
+  // of backslashes opens or closes a string going backwards just as going
+  // forwards. Returns false if there is no such id, in which case the page
+  // is fetched after this one has been decoded as usual.
+  static bool scanLastId(const std::string& data, tweet_id& id)
+  {
+    const char* begin = data.data();
+    const char* cur = begin + data.size();
+
+    while ((cur != begin) && isSpace(cur[-1]))
+    {
+      cur--;
+    }
+
+    if ((cur == begin) || (cur[-1] != ']'))
     {
-      std::ostringstream urlstr;
-      urlstr << url_;
+      return false;
+    }
 
-      std::list<std::string> arguments;
+    cur--;
+
+    while ((cur != begin) && isSpace(cur[-1]))
+    {
+      cur--;
+    }
+
+    if ((cur == begin) || (cur[-1] != '}'))
+    {
+      return false;
+    }
+
+    const char* end = cur;
+    int depth = 0;
+    bool inString = false;
+
+    do
+    {
+      cur--;
 
-      if (i > 0)
+      if (*cur == '"')
       {
-        arguments.push_back("max_id=" + std::to_string(maxId));
+        const char* slash = cur;
+        while ((slash != begin) && (slash[-1] == '\\'))
+        {
+          slash--;
+        }
+
+        if ((cur - slash) % 2 == 0)
+        {
+          inString = !inString;
+        }
+      } else if (!inString)
+      {
+        if ((*cur == '}') || (*cur == ']'))
+        {
+          depth++;
+        } else if ((*cur == '{') || (*cur == '['))
+        {
+          depth--;
+        }
       }
+    } while ((cur != begin) && (depth > 0));
+
+    if (depth != 0)
+    {
+      return false;
+    }
 
-      if (hasSince_)
+    decoder last(cur, end);
+    last.beginObject();
+
+    std::string key;
+    while (last.nextKey(key))
+    {
+      if (key == "id")
       {
-        arguments.push_back("since_id=" + std::to_string(sinceId_));
+        id = last.readUnsigned();
+
+        return true;
       }
 
-      if (!arguments.empty())
+      last.skipValue();
+    }
+
+    return false;
+  }
+
+  std::string timeline::pageUrl(
+    bool hasSince,
+    tweet_id sinceId,
+    bool hasMax,
+    tweet_id maxId) const
+  {
+    std::ostringstream urlstr;
+    urlstr << url_;
+
+    std::list<std::string> arguments;
+
+    if (hasMax)
+    {
+      arguments.push_back("max_id=" + std::to_string(maxId));
+    }
+
+    // Twitter leaves the since id itself out, so this asks for one less,
+    // and the since id's tweet coming back shows that a page reached it.
+    if (hasSince)
+    {
+      arguments.push_back(
+        "since_id=" + std::to_string((sinceId > 0) ? sinceId - 1 : 0));
+    }
+
+    if (count_ > 0)
+    {
+      arguments.push_back("count=" + std::to_string(count_));
+    }
+
+    if (trimUser_)
+    {
+      arguments.push_back("trim_user=true");
+    }
+
+    if (!includeEntities_)
+    {
+      arguments.push_back("include_entities=false");
+    }
+
+    if (extended_)
+    {
+      arguments.push_back("tweet_mode=extended");
+    }
+
+    if (!arguments.empty())
+    {
+      urlstr << "?";
+      urlstr << hatkirby::implode(
+        std::begin(arguments), std::end(arguments), "&");
+    }
+
+    return urlstr.str();
+  }
+
+  std::list<tweet> timeline::poll()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    tweet_id maxId = 0;
+    bool truncated = false;
+    std::list<tweet> result;
+    std::future<std::string> pending;
+
+    retry_policy retry =
+      client_ ? client_->getRetryPolicy() : retry_policy::none();
+
+    for (size_t i = 0; i < pages_; i++)
+    {
+      std::string response;
+
+      if (pending.valid())
       {
-        urlstr << "?";
-        urlstr << hatkirby::implode(
-          std::begin(arguments), std::end(arguments), "&");
+        response = pending.get();
+      } else {
+        std::string theUrl = pageUrl(hasSince_, sinceId_, i > 0, maxId);
+
+        response = retry.run([&] () {
+          return get(auth_,
+            theUrl,
+            client_ ? &client_->getConnectionPool() : nullptr,
+            client_ ? &client_->getRateLimiter() : nullptr)
+          .perform();
+        });
       }
 
-      std::string theUrl = urlstr.str();
-      std::string response = get(auth_, theUrl).perform();
+      // A page that reaches back to the newest tweet already seen is the
+      // last one needed.
+      auto reachesSince = [this] (tweet_id oldest) {
+        return hasSince_ && (oldest <= sinceId_);
+      };
+
+      bool more = false;
+      bool reached = false;
+      tweet_id oldest;
 
       try
       {
-        nlohmann::json rjs = nlohmann::json::parse(response);
-
-        if (rjs.empty())
+        // With a client to run it on, the next page is requested before this
+        // one is decoded, so that the decoding happens while it is on its way.
+        // That can't be waited for on the engine's own thread.
+        tweet_id lastId;
+        if (client_ && !client_->getEngine().onLoopThread()
+          && (i + 1 < pages_) && scanLastId(response, lastId)
+          && !reachesSince(lastId))
         {
-          break;
+          pending = client_->fetchAsync(
+            pageUrl(hasSince_, sinceId_, true, lastId - 1));
         }
 
-        for (auto& single : rjs)
+        decoder input(response);
+        input.beginArray();
+
+        while (input.nextElement())
         {
-          result.emplace_back(single.dump());
+          result.emplace_back(input,
+            client_ ? &client_->getUserTable() : nullptr);
+
+          oldest = result.back().getID();
+          more = true;
+
+          if (reachesSince(oldest))
+          {
+            result.pop_back();
+            reached = true;
+          }
         }
+
+        input.finish();
       } catch (const std::invalid_argument& error)
       {
         std::throw_with_nested(invalid_response(response));
@@ -68,16 +293,327 @@ namespace twitter {
         std::throw_with_nested(invalid_response(response));
       }
 
-      maxId = result.back().getID() - 1;
+      if (client_)
+      {
+        client_->getConnectionPool().recycle(std::move(response));
+      }
+
+      if (!more || reached)
+      {
+        truncated = false;
+
+        break;
+      }
+
+      maxId = oldest - 1;
+      truncated = true;
     }
 
-    if (!result.empty())
+    // Running out of pages before reaching the since id leaves a gap
+    // between it and the oldest tweet fetched. It is only kept for backfill
+    // to fill in; otherwise its tweets are skipped.
+    bool backfilling;
+
     {
-      sinceId_ = result.front().getID();
-      hasSince_ = true;
+      std::lock_guard<std::mutex> backfillLock(backfill_->mutex);
+
+      backfilling = backfill_->enabled;
+    }
+
+    tweet_id gapSince = sinceId_;
+    bool hasGap = truncated && hasSince_ && backfilling;
+    bool hasNewest = hasSince_ || !result.empty();
+    tweet_id newest = result.empty() ? sinceId_ : result.front().getID();
+
+    if (store_ && hasNewest)
+    {
+      // Gaps are not saved, so the checkpoint stays at the start of the
+      // oldest one, and a restarted process fetches what was missed again.
+      tweet_id checkpoint = hasGap ? gapSince : newest;
+
+      {
+        std::lock_guard<std::mutex> backfillLock(backfill_->mutex);
+
+        if (!backfill_->gaps.empty())
+        {
+          checkpoint = std::min(checkpoint, backfill_->gaps.front().sinceId);
+        }
+      }
+
+      tweet_id saved;
+      if (!store_->load(storeKey_, saved) || (saved != checkpoint))
+      {
+        store_->save(storeKey_, checkpoint);
+      }
+    }
+
+    sinceId_ = newest;
+    hasSince_ = hasNewest;
+
+    std::lock_guard<std::mutex> backfillLock(backfill_->mutex);
+
+    if (hasGap)
+    {
+      backfill_->gaps.push_back({gapSince, maxId});
+    }
+
+    result.splice(std::end(result), backfill_->found);
+
+    if (backfill_->enabled && !backfill_->running && !backfill_->gaps.empty())
+    {
+      scheduleBackfill(std::chrono::steady_clock::now() + backfillDelay);
     }
 
     return result;
   }
 
+  void timeline::scheduleBackfill(std::chrono::steady_clock::time_point when)
+  {
+    std::shared_ptr<backfill_state> state = backfill_;
+    state->running = true;
+
+    client_->schedule(when, [this, state] () {
+      backfillPage(state);
+    });
+  }
+
+  void timeline::backfillPage(std::shared_ptr<backfill_state> state)
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+
+    // The timeline may be gone by now, so nothing else is touched until
+    // this has been checked.
+    if (state->stopped || !state->enabled || state->gaps.empty())
+    {
+      state->running = false;
+
+      return;
+    }
+
+    rate_limiter::window window;
+    if (client_->getRateLimiter().getWindow(
+        rate_limiter::endpointOf(url_), window)
+      && (window.remaining <= backfillReserve))
+    {
+      auto wait = window.reset - rate_limiter::clock::now();
+
+      if (wait > rate_limiter::clock::duration::zero())
+      {
+        client_->schedule(
+          std::chrono::steady_clock::now() + wait,
+          [this, state] () {
+            backfillPage(state);
+          });
+
+        return;
+      }
+    }
+
+    gap next = state->gaps.front();
+    std::string theUrl = pageUrl(true, next.sinceId, true, next.maxId);
+
+    state->busy++;
+    lock.unlock();
+
+    client_->submit(
+      std::make_unique<get>(auth_,
+        theUrl,
+        &client_->getConnectionPool(),
+        &client_->getRateLimiter()),
+      [this, state, next] (std::string response) {
+        backfillReceived(state, next, std::move(response));
+      },
+      [state] (std::exception_ptr) {
+        // The gap stays, and the next poll starts on it again.
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        state->running = false;
+      });
+
+    lock.lock();
+
+    state->busy--;
+    state->idle.notify_all();
+  }
+
+  void timeline::backfillReceived(
+    std::shared_ptr<backfill_state> state,
+    gap next,
+    std::string response)
+  {
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+
+      if (state->stopped)
+      {
+        state->running = false;
+
+        return;
+      }
+
+      state->busy++;
+    }
+
+    auto release = [&state] () {
+      std::lock_guard<std::mutex> lock(state->mutex);
+
+      state->busy--;
+      state->idle.notify_all();
+    };
+
+    std::list<tweet> found;
+    bool more = false;
+    bool reached = false;
+    tweet_id oldest;
+
+    try
+    {
+      decoder input(response);
+      input.beginArray();
+
+      while (input.nextElement())
+      {
+        found.emplace_back(input, &client_->getUserTable());
+
+        oldest = found.back().getID();
+        more = true;
+
+        if (oldest <= next.sinceId)
+        {
+          found.pop_back();
+          reached = true;
+        }
+      }
+
+      input.finish();
+    } catch (const std::invalid_argument& error)
+    {
+      release();
+      std::throw_with_nested(invalid_response(response));
+    } catch (const std::domain_error& error)
+    {
+      release();
+      std::throw_with_nested(invalid_response(response));
+    } catch (...)
+    {
+      release();
+      throw;
+    }
+
+    client_->getConnectionPool().recycle(std::move(response));
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    // Turning backfill off drops the gaps, including this one.
+    if (!state->gaps.empty()
+      && (state->gaps.front().sinceId == next.sinceId)
+      && (state->gaps.front().maxId == next.maxId))
+    {
+      state->found.splice(std::end(state->found), found);
+
+      if (!more || reached)
+      {
+        state->gaps.pop_front();
+      } else {
+        state->gaps.front().maxId = oldest - 1;
+      }
+    }
+
+    state->busy--;
+    state->idle.notify_all();
+
+    if (state->stopped)
+    {
+      state->running = false;
+    } else {
+      scheduleBackfill(std::chrono::steady_clock::now() + backfillDelay);
+    }
+  }
+
+  bool timeline::getSinceId(tweet_id& id) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (hasSince_)
+    {
+      id = sinceId_;
+    }
+
+    return hasSince_;
+  }
+
+  void timeline::setSinceId(tweet_id id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    sinceId_ = id;
+    hasSince_ = true;
+  }
+
+  void timeline::setPages(size_t pages)
+  {
+    pages_ = pages;
+  }
+
+  void timeline::setCount(size_t count)
+  {
+    count_ = count;
+  }
+
+  void timeline::setTrimUser(bool trimUser)
+  {
+    trimUser_ = trimUser;
+  }
+
+  void timeline::setIncludeEntities(bool includeEntities)
+  {
+    includeEntities_ = includeEntities;
+  }
+
+  void timeline::setExtended(bool extended)
+  {
+    extended_ = extended;
+  }
+
+  void timeline::setCheckpointStore(checkpoint_store& store, std::string key)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    store_ = &store;
+    storeKey_ = std::move(key);
+
+    tweet_id id;
+    if (store_->load(storeKey_, id))
+    {
+      sinceId_ = id;
+      hasSince_ = true;
+    }
+  }
+
+  std::vector<timeline::gap> timeline::getGaps() const
+  {
+    std::lock_guard<std::mutex> lock(backfill_->mutex);
+
+    return std::vector<gap>(
+      std::begin(backfill_->gaps),
+      std::end(backfill_->gaps));
+  }
+
+  void timeline::setBackfill(bool backfill)
+  {
+    std::lock_guard<std::mutex> lock(backfill_->mutex);
+
+    backfill_->enabled = backfill && client_;
+
+    if (!backfill_->enabled)
+    {
+      backfill_->gaps.clear();
+    }
+
+    if (backfill_->enabled && !backfill_->running && !backfill_->gaps.empty())
+    {
+      scheduleBackfill(std::chrono::steady_clock::now());
+    }
+  }
+
 };
@@ -1,29 +1,142 @@
 #ifndef TIMELINE_H_D359681C
 #define TIMELINE_H_D359681C
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "auth.h"
+#include "checkpoint_store.h"
 #include "tweet.h"
 
 namespace twitter {
 
+  class client;
+
   class timeline {
   public:
 
+    // Tweets newer than sinceId and no newer than maxId, which a poll
+    // skipped over because it ran out of pages before reaching its since
+    // id.
+    struct gap {
+      tweet_id sinceId;
+      tweet_id maxId;
+    };
+
     timeline(
       const auth& tauth,
       std::string url);
 
+    timeline(
+      const client& tclient,
+      std::string url);
+
+    timeline(const timeline& other) = delete;
+    timeline& operator=(const timeline& other) = delete;
+
+    // Backfill timers and requests that are still pending are ignored once
+    // the timeline is gone; only a response that is being handled right then
+    // is waited for.
+    ~timeline();
+
+    // Concurrent polls take turns, so that each new tweet is returned by
+    // only one of them.
     std::list<tweet> poll();
 
+    // Returns nullptr if the timeline was not created by a client.
+    const client* getClient() const
+    {
+      return client_;
+    }
+
+    const std::string& getUrl() const
+    {
+      return url_;
+    }
+
+    // The newest tweet seen so far, which the next poll starts after.
+    // Returns false if nothing has been seen yet.
+    bool getSinceId(tweet_id& id) const;
+
+    // Makes the next poll return only tweets newer than this one, instead of
+    // going back through five pages of history.
+    void setSinceId(tweet_id id);
+
+    // The most pages a poll fetches before giving up on reaching the since
+    // id. Five by default.
+    void setPages(size_t pages);
+
+    // Tweets asked for per page; zero leaves it up to Twitter.
+    void setCount(size_t count);
+
+    // Asks for only the id of each tweet's author. Authors are looked up in
+    // the client's user table, and those that haven't been seen yet are
+    // left with just their id.
+    void setTrimUser(bool trimUser);
+
+    // Leaving entities out means tweets come back without mentions.
+    void setIncludeEntities(bool includeEntities);
+
+    // Asks for tweet_mode=extended, so that text is never truncated.
+    void setExtended(bool extended);
+
+    // Restores the since id from the store, if it has one for the key, and
+    // saves it there after each poll that moves it. While backfill has gaps
+    // left, what is saved is the since id of the oldest one instead, so that a
+    // restarted process fetches them again, along with some tweets that
+    // were already returned. If saving fails, the poll throws storage_error
+    // and its tweets are returned again by the next poll.
+    void setCheckpointStore(checkpoint_store& store, std::string key);
+
+    // The gaps that have not been backfilled yet, oldest first. Gaps are
+    // only kept while backfill is on.
+    std::vector<gap> getGaps() const;
+
+    // Fetches gaps one page at a time on the client's engine, leaving the
+    // last few calls in each rate limit window to polls. Tweets found this
+    // way are returned by the next poll, after its new ones. A failed page
+    // is tried again after the next poll. Turning it off drops the gaps
+    // that are left. Needs a client.
+    void setBackfill(bool backfill);
+
   private:
 
+    struct backfill_state;
+
+    std::string pageUrl(
+      bool hasSince,
+      tweet_id sinceId,
+      bool hasMax,
+      tweet_id maxId) const;
+
+    void scheduleBackfill(std::chrono::steady_clock::time_point when);
+
+    void backfillPage(std::shared_ptr<backfill_state> state);
+
+    void backfillReceived(
+      std::shared_ptr<backfill_state> state,
+      gap next,
+      std::string response);
+
     const auth& auth_;
+    const client* client_ = nullptr;
     std::string url_;
     bool hasSince_ = false;
-    tweet_id sinceId_;
+    tweet_id sinceId_ = 0;
+    std::atomic<size_t> pages_ {5};
+    std::atomic<size_t> count_ {0};
+    std::atomic<bool> trimUser_ {false};
+    std::atomic<bool> includeEntities_ {true};
+    std::atomic<bool> extended_ {false};
+    checkpoint_store* store_ = nullptr;
+    std::string storeKey_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<backfill_state> backfill_;
   };
 
 }
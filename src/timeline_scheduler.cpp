@@ -0,0 +1,285 @@
+#include "timeline_scheduler.h"
+#include <algorithm>
+#include "client.h"
+#include "codes.h"
+#include "rate_limiter.h"
+
+namespace twitter {
+
+  // Enough that most polls fit in one page, so that a timeline is rarely
+  // polled for nothing or left to pile up more than a page.
+  static const double targetPerPoll = 20.0;
+
+  // How much weight the latest poll has in the arrival rate.
+  static const double smoothing = 0.3;
+
+  timeline_scheduler::timeline_scheduler(
+    size_t workers,
+    std::chrono::seconds minInterval,
+    std::chrono::seconds maxInterval) :
+      minInterval_(minInterval.count()),
+      maxInterval_(std::max(minInterval, maxInterval).count())
+  {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++)
+    {
+      workers_.emplace_back(&timeline_scheduler::run, this);
+    }
+  }
+
+  timeline_scheduler::~timeline_scheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      stopping_ = true;
+    }
+
+    wake_.notify_all();
+
+    for (std::thread& worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+  void timeline_scheduler::add(
+    timeline& tline,
+    tweet_callback onTweets,
+    error_callback onError)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    entries_.emplace_back();
+
+    entry& e = entries_.back();
+    e.id = nextId_++;
+    e.tline = &tline;
+    e.onTweets = std::move(onTweets);
+    e.onError = std::move(onError);
+    e.interval = minInterval_;
+    e.position = queue_.emplace(clock::now(), &e);
+
+    wake_.notify_one();
+  }
+
+  void timeline_scheduler::remove(timeline& tline)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = std::find_if(std::begin(entries_), std::end(entries_),
+      [&] (const entry& e) {
+        return (e.tline == &tline) && !e.removed;
+      });
+
+    if (it == std::end(entries_))
+    {
+      return;
+    }
+
+    it->removed = true;
+
+    if (!it->busy)
+    {
+      queue_.erase(it->position);
+      entries_.erase(it);
+
+      return;
+    }
+
+    // The worker polling it drops it once it is done.
+    if (it->worker == std::this_thread::get_id())
+    {
+      return;
+    }
+
+    unsigned long long id = it->id;
+
+    idle_.wait(lock, [&] () {
+      return std::none_of(std::begin(entries_), std::end(entries_),
+        [id] (const entry& e) {
+          return e.id == id;
+        });
+    });
+  }
+
+  size_t timeline_scheduler::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return std::count_if(std::begin(entries_), std::end(entries_),
+      [] (const entry& e) {
+        return !e.removed;
+      });
+  }
+
+  void timeline_scheduler::run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;)
+    {
+      if (stopping_)
+      {
+        return;
+      }
+
+      if (queue_.empty())
+      {
+        wake_.wait(lock);
+
+        continue;
+      }
+
+      auto next = std::begin(queue_);
+
+      if (next->first > clock::now())
+      {
+        wake_.wait_until(lock, next->first);
+
+        continue;
+      }
+
+      entry& e = *next->second;
+      queue_.erase(next);
+      e.busy = true;
+      e.worker = std::this_thread::get_id();
+
+      lock.unlock();
+
+      size_t count = 0;
+      bool failed = false;
+
+      try
+      {
+        std::list<tweet> tweets = e.tline->poll();
+        count = tweets.size();
+
+        if (!tweets.empty() && e.onTweets)
+        {
+          e.onTweets(*e.tline, std::move(tweets));
+        }
+      } catch (...)
+      {
+        failed = true;
+
+        if (e.onError)
+        {
+          try
+          {
+            e.onError(*e.tline, std::current_exception());
+          } catch (...)
+          {
+            // There is nobody left to report this to.
+          }
+        }
+      }
+
+      clock::time_point now = clock::now();
+
+      lock.lock();
+
+      e.busy = false;
+
+      if (e.removed)
+      {
+        entries_.remove_if([&] (const entry& other) {
+          return &other == &e;
+        });
+
+        idle_.notify_all();
+      } else {
+        adapt(e, count, failed, now);
+
+        e.position = queue_.emplace(
+          now + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(e.interval)),
+          &e);
+
+        wake_.notify_one();
+      }
+    }
+  }
+
+  void timeline_scheduler::adapt(
+    entry& e,
+    size_t count,
+    bool failed,
+    clock::time_point now)
+  {
+    if (failed)
+    {
+      e.interval = std::min(e.interval * 2, maxInterval_);
+    } else {
+      // The first poll catches up on history, which says nothing about how
+      // fast tweets arrive.
+      if (e.polled)
+      {
+        double elapsed = std::chrono::duration<double>(now - e.lastPoll).count();
+
+        if (elapsed > 0)
+        {
+          double observed = count / elapsed;
+
+          if (e.hasRate)
+          {
+            e.rate = smoothing * observed + (1 - smoothing) * e.rate;
+          } else {
+            e.rate = observed;
+            e.hasRate = true;
+          }
+        }
+      }
+
+      if (e.rate > 0)
+      {
+        e.interval = targetPerPoll / e.rate;
+      } else if (e.polled)
+      {
+        e.interval *= 1.5;
+      }
+
+      e.interval = std::min(std::max(e.interval, minInterval_), maxInterval_);
+
+      e.polled = true;
+      e.lastPoll = now;
+    }
+
+    e.interval = std::max(e.interval, budgetInterval(e));
+  }
+
+  double timeline_scheduler::budgetInterval(const entry& e) const
+  {
+    const client* tclient = e.tline->getClient();
+    if (!tclient)
+    {
+      return 0;
+    }
+
+    std::string endpoint = rate_limiter::endpointOf(e.tline->getUrl());
+
+    rate_limiter::window w;
+    if (!tclient->getRateLimiter().getWindow(endpoint, w))
+    {
+      return 0;
+    }
+
+    double untilReset =
+      std::chrono::duration<double>(w.reset - rate_limiter::clock::now()).count();
+
+    if (untilReset <= 0)
+    {
+      return 0;
+    }
+
+    size_t sharing = std::count_if(std::begin(entries_), std::end(entries_),
+      [&] (const entry& other) {
+        return !other.removed
+          && other.tline->getClient()
+          && (&other.tline->getClient()->getRateLimiter() == &tclient->getRateLimiter())
+          && (rate_limiter::endpointOf(other.tline->getUrl()) == endpoint);
+      });
+
+    return untilReset * sharing / std::max(w.remaining, 1L);
+  }
+
+}
@@ -0,0 +1,101 @@
+#ifndef TIMELINE_SCHEDULER_H_0B6E93A4
+#define TIMELINE_SCHEDULER_H_0B6E93A4
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "timeline.h"
+#include "tweet.h"
+
+namespace twitter {
+
+  // Polls many timelines from a small, fixed set of worker threads. Each
+  // timeline's interval follows how often tweets arrive on it, aiming for a
+  // steady number of new tweets per poll, but never polls faster than its
+  // client's rate limit window can sustain when shared by all of the
+  // scheduled timelines on the same endpoint. Quiet timelines and ones that
+  // fail back off towards the maximum interval.
+  //
+  // Callbacks run on the worker threads.
+  class timeline_scheduler {
+  public:
+
+    using tweet_callback = std::function<void(timeline&, std::list<tweet>)>;
+    using error_callback = std::function<void(timeline&, std::exception_ptr)>;
+
+    using clock = std::chrono::steady_clock;
+
+    explicit timeline_scheduler(
+      size_t workers = 2,
+      std::chrono::seconds minInterval = std::chrono::seconds(60),
+      std::chrono::seconds maxInterval = std::chrono::seconds(15 * 60));
+
+    timeline_scheduler(const timeline_scheduler& other) = delete;
+    timeline_scheduler& operator=(const timeline_scheduler& other) = delete;
+
+    // Waits for polls in progress to finish.
+    ~timeline_scheduler();
+
+    // Polls the timeline straight away and then for as long as it is
+    // scheduled. The callback is only called when there are new tweets.
+    void add(
+      timeline& tline,
+      tweet_callback onTweets,
+      error_callback onError = nullptr);
+
+    // Once this returns, the timeline will not be polled or called back for
+    // again, unless it is called from the timeline's own callback, in which
+    // case that is the last one.
+    void remove(timeline& tline);
+
+    size_t size() const;
+
+  private:
+
+    struct entry {
+      unsigned long long id;
+      timeline* tline;
+      tweet_callback onTweets;
+      error_callback onError;
+      std::multimap<clock::time_point, entry*>::iterator position;
+      bool busy = false;
+      bool removed = false;
+      std::thread::id worker;
+      clock::time_point lastPoll;
+      bool polled = false;
+      double interval;
+      double rate = 0.0;
+      bool hasRate = false;
+    };
+
+    void run();
+
+    void adapt(entry& e, size_t count, bool failed, clock::time_point now);
+
+    // How long the timeline has to wait between polls to stay within its
+    // rate limit window, in seconds.
+    double budgetInterval(const entry& e) const;
+
+    const double minInterval_;
+    const double maxInterval_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::list<entry> entries_;
+    std::multimap<clock::time_point, entry*> queue_;
+    unsigned long long nextId_ = 0;
+    bool stopping_ = false;
+
+    std::vector<std::thread> workers_;
+  };
+
+}
+
+#endif /* end of include guard: TIMELINE_SCHEDULER_H_0B6E93A4 */
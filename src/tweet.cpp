@@ -4,50 +4,252 @@
 #include "util.h"
 #include "codes.h"
 #include "client.h"
+#include "decoder.h"
+#include "user_table.h"
 
 namespace twitter {
 
-  tweet::tweet(std::string data)
+  static std::time_t parseCreatedAt(const std::string& created_at)
+  {
+    std::tm ctt = { 0 };
+    std::stringstream createdAtStream;
+    createdAtStream << created_at;
+    createdAtStream >> std::get_time(&ctt, "%a %b %d %H:%M:%S +0000 %Y");
+
+    return twitter::timegm(&ctt);
+  }
+
+  tweet::tweet(std::string data) try :
+    tweet(nlohmann::json::parse(data))
+  {
+  } catch (const std::invalid_argument& error)
+  {
+    std::throw_with_nested(malformed_object("tweet", data));
+  }
+
+  tweet::tweet(const nlohmann::json& data)
   {
     try
     {
-      auto json = nlohmann::json::parse(data);
-      _id = json["id"].get<tweet_id>();
-      _text = json["text"].get<std::string>();
-      _author = new user(json["user"].dump());
-
-      std::tm ctt = { 0 };
-      std::stringstream createdAtStream;
-      createdAtStream << json["created_at"].get<std::string>();
-      createdAtStream >> std::get_time(&ctt, "%a %b %d %H:%M:%S +0000 %Y");
-      _created_at = twitter::timegm(&ctt);
-
-      if (!json["retweeted_status"].is_null())
+      _id = data.at("id").get<tweet_id>();
+
+      auto fullText = data.find("full_text");
+      if (fullText != std::end(data))
+      {
+        _text = fullText->get<std::string>();
+      } else {
+        _text = data.at("text").get<std::string>();
+      }
+
+      const nlohmann::json& author = data.at("user");
+      if (author.find("screen_name") == std::end(author))
+      {
+        _author = std::make_shared<const user>(author.at("id").get<user_id>());
+      } else {
+        _author = std::make_shared<const user>(author);
+      }
+
+      _created_at = parseCreatedAt(data.at("created_at").get<std::string>());
+
+      auto retweet = data.find("retweeted_status");
+      if (retweet != std::end(data) && !retweet->is_null())
       {
         _is_retweet = true;
 
-        _retweeted_status = new tweet(json["retweeted_status"].dump());
+        _retweeted_status = new tweet(*retweet);
       }
 
-      if (!json["entities"].is_null())
+      auto entities = data.find("entities");
+      if (entities != std::end(data) && !entities->is_null())
       {
-        auto entities = json["entities"];
-        if (!entities["user_mentions"].is_null())
+        auto mentions = entities->find("user_mentions");
+        if (mentions != entities->end() && !mentions->is_null())
         {
-          for (auto mention : entities["user_mentions"])
+          for (const auto& mention : *mentions)
           {
             _mentions.emplace_back(
-              mention["id"].get<user_id>(),
-              mention["screen_name"].get<std::string>());
+              mention.at("id").get<user_id>(),
+              mention.at("screen_name").get<std::string>());
           }
         }
       }
+    } catch (const std::out_of_range& error)
+    {
+      std::throw_with_nested(malformed_object("tweet", data.dump()));
+    } catch (const std::domain_error& error)
+    {
+      std::throw_with_nested(malformed_object("tweet", data.dump()));
+    }
+  }
+
+  // Tweets fetched with trim_user carry only the author's id and id_str,
+  // while a full user has other members right after those.
+  static bool isTrimmedUser(decoder input, user_id& id)
+  {
+    bool hasId = false;
+
+    input.beginObject();
+
+    std::string key;
+    while (input.nextKey(key))
+    {
+      if (key == "id")
+      {
+        id = input.readUnsigned();
+        hasId = true;
+      } else if (key == "id_str")
+      {
+        input.skipValue();
+      } else {
+        return false;
+      }
+    }
+
+    return hasId;
+  }
+
+  tweet::tweet(decoder& input, user_table* users)
+  {
+    try
+    {
+      bool hasId = false;
+      bool hasText = false;
+      bool hasAuthor = false;
+      bool hasCreatedAt = false;
+
+      input.beginObject();
+
+      std::string key;
+      while (input.nextKey(key))
+      {
+        if (key == "id")
+        {
+          _id = input.readUnsigned();
+          hasId = true;
+        } else if ((key == "text") || (key == "full_text"))
+        {
+          _text = input.readString();
+          hasText = true;
+        } else if (key == "user")
+        {
+          decoder userData = input.captureValue();
+          user_id authorId;
+
+          if (isTrimmedUser(userData, authorId))
+          {
+            if (users)
+            {
+              _author = users->find(authorId);
+            }
+
+            if (!_author)
+            {
+              _author = std::make_shared<const user>(authorId);
+            }
+          } else {
+            user author(userData);
+
+            if (users)
+            {
+              _author = users->intern(std::move(author));
+            } else {
+              _author = std::make_shared<const user>(std::move(author));
+            }
+          }
+
+          hasAuthor = true;
+        } else if (key == "created_at")
+        {
+          _created_at = parseCreatedAt(input.readString());
+          hasCreatedAt = true;
+        } else if (key == "retweeted_status")
+        {
+          if (!input.readNull())
+          {
+            _is_retweet = true;
+
+            _retweeted_status = new tweet(input, users);
+          }
+        } else if (key == "entities")
+        {
+          if (!input.readNull())
+          {
+            readEntities(input);
+          }
+        } else {
+          input.skipValue();
+        }
+      }
+
+      if (!hasId || !hasText || !hasAuthor || !hasCreatedAt)
+      {
+        throw std::out_of_range("tweet is missing a required member");
+      }
+    } catch (const std::out_of_range& error)
+    {
+      std::throw_with_nested(malformed_object("tweet", input.getData()));
     } catch (const std::invalid_argument& error)
     {
-      std::throw_with_nested(malformed_object("tweet", data));
+      std::throw_with_nested(malformed_object("tweet", input.getData()));
     } catch (const std::domain_error& error)
     {
-      std::throw_with_nested(malformed_object("tweet", data));
+      std::throw_with_nested(malformed_object("tweet", input.getData()));
+    }
+  }
+
+  void tweet::readEntities(decoder& input)
+  {
+    input.beginObject();
+
+    std::string key;
+    while (input.nextKey(key))
+    {
+      if (key != "user_mentions")
+      {
+        input.skipValue();
+
+        continue;
+      }
+
+      if (input.readNull())
+      {
+        continue;
+      }
+
+      input.beginArray();
+
+      while (input.nextElement())
+      {
+        user_id mention_id = 0;
+        std::string screen_name;
+        bool hasId = false;
+        bool hasScreenName = false;
+
+        input.beginObject();
+
+        std::string mentionKey;
+        while (input.nextKey(mentionKey))
+        {
+          if (mentionKey == "id")
+          {
+            mention_id = input.readUnsigned();
+            hasId = true;
+          } else if (mentionKey == "screen_name")
+          {
+            screen_name = input.readString();
+            hasScreenName = true;
+          } else {
+            input.skipValue();
+          }
+        }
+
+        if (!hasId || !hasScreenName)
+        {
+          throw std::out_of_range("mention is missing a required member");
+        }
+
+        _mentions.emplace_back(mention_id, std::move(screen_name));
+      }
     }
   }
 
@@ -5,18 +5,27 @@
 #include <vector>
 #include <utility>
 #include <ctime>
+#include <memory>
 #include "../vendor/hkutil/hkutil/recptr.h"
+#include "../vendor/json/json.hpp"
 #include "user.h"
 
 namespace twitter {
 
   typedef unsigned long long tweet_id;
 
+  class decoder;
+  class user_table;
+
   class tweet {
   public:
 
     tweet(std::string data);
 
+    explicit tweet(const nlohmann::json& data);
+
+    explicit tweet(decoder& input, user_table* users = nullptr);
+
     tweet_id getID() const
     {
       return _id;
@@ -63,9 +72,11 @@ namespace twitter {
 
   private:
 
+    void readEntities(decoder& input);
+
     tweet_id _id;
     std::string _text;
-    hatkirby::recptr<user> _author;
+    std::shared_ptr<const user> _author;
     std::time_t _created_at;
     bool _is_retweet = false;
     hatkirby::recptr<tweet> _retweeted_status;
@@ -0,0 +1,222 @@
+#include "tweet_store.h"
+#include <algorithm>
+
+namespace twitter {
+
+  // About one percent false positives per generation.
+  static const size_t bloomBitsPerId = 10;
+  static const size_t bloomHashes = 7;
+
+  static unsigned long long mix(unsigned long long x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+    return x ^ (x >> 31);
+  }
+
+  tweet_store::tweet_store(size_t capacity, size_t maxBytes) :
+    capacity_(std::max<size_t>(capacity, 1)),
+    maxBytes_(maxBytes),
+    ring_(capacity_),
+    bloomGeneration_(capacity_ * 4)
+  {
+    size_t words = (bloomGeneration_ * bloomBitsPerId + 63) / 64;
+
+    bloom_[0].resize(words);
+    bloom_[1].resize(words);
+  }
+
+  bool tweet_store::insert(tweet t)
+  {
+    size_t size = footprint(t);
+
+    // Storing it would mean evicting everything else and still going over.
+    if (maxBytes_ > 0 && size > maxBytes_)
+    {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index_.count(t.getID()))
+    {
+      return false;
+    }
+
+    while ((count_ > 0) &&
+      ((count_ == capacity_) || (maxBytes_ > 0 && bytes_ + size > maxBytes_)))
+    {
+      evictOldest();
+    }
+
+    remember(t.getID());
+
+    auto stored = std::make_shared<const tweet>(std::move(t));
+    index_.emplace(stored->getID(), stored);
+    ring_[(head_ + count_) % capacity_] = std::move(stored);
+    count_++;
+    bytes_ += size;
+
+    return true;
+  }
+
+  std::shared_ptr<const tweet> tweet_store::find(tweet_id id) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(id);
+    if (it == std::end(index_))
+    {
+      return nullptr;
+    }
+
+    return it->second;
+  }
+
+  bool tweet_store::contains(tweet_id id) const
+  {
+    return static_cast<bool>(find(id));
+  }
+
+  bool tweet_store::mightHaveSeen(tweet_id id) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return bloomContains(id);
+  }
+
+  std::vector<std::shared_ptr<const tweet>> tweet_store::getRecent(
+    size_t limit) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t n = (limit == 0) ? count_ : std::min(limit, count_);
+
+    std::vector<std::shared_ptr<const tweet>> result;
+    result.reserve(n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+      result.push_back(ring_[(head_ + count_ - 1 - i) % capacity_]);
+    }
+
+    return result;
+  }
+
+  size_t tweet_store::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return count_;
+  }
+
+  size_t tweet_store::getMemoryUsage() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return bytes_;
+  }
+
+  void tweet_store::clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t i = 0; i < count_; i++)
+    {
+      ring_[(head_ + i) % capacity_].reset();
+    }
+
+    index_.clear();
+    head_ = 0;
+    count_ = 0;
+    bytes_ = 0;
+
+    std::fill(std::begin(bloom_[0]), std::end(bloom_[0]), 0);
+    std::fill(std::begin(bloom_[1]), std::end(bloom_[1]), 0);
+    bloomInserted_ = 0;
+  }
+
+  size_t tweet_store::footprint(const tweet& t)
+  {
+    size_t result = sizeof(tweet) + t.getText().size();
+
+    for (const auto& mention : t.getMentions())
+    {
+      result += sizeof(mention) + mention.second.size();
+    }
+
+    if (t.isRetweet())
+    {
+      result += footprint(t.getRetweet());
+    }
+
+    return result;
+  }
+
+  void tweet_store::evictOldest()
+  {
+    std::shared_ptr<const tweet>& oldest = ring_[head_];
+
+    index_.erase(oldest->getID());
+    bytes_ -= footprint(*oldest);
+    oldest.reset();
+
+    head_ = (head_ + 1) % capacity_;
+    count_--;
+  }
+
+  void tweet_store::remember(tweet_id id)
+  {
+    if (bloomInserted_ == bloomGeneration_)
+    {
+      bloomCurrent_ = 1 - bloomCurrent_;
+      std::fill(
+        std::begin(bloom_[bloomCurrent_]),
+        std::end(bloom_[bloomCurrent_]),
+        0);
+
+      bloomInserted_ = 0;
+    }
+
+    std::vector<unsigned long long>& bits = bloom_[bloomCurrent_];
+    size_t total = bits.size() * 64;
+    unsigned long long h1 = mix(id);
+    unsigned long long h2 = mix(h1) | 1;
+
+    for (size_t i = 0; i < bloomHashes; i++)
+    {
+      size_t bit = (h1 + i * h2) % total;
+      bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+
+    bloomInserted_++;
+  }
+
+  bool tweet_store::bloomContains(tweet_id id) const
+  {
+    size_t total = bloom_[0].size() * 64;
+    unsigned long long h1 = mix(id);
+    unsigned long long h2 = mix(h1) | 1;
+
+    for (const std::vector<unsigned long long>& bits : bloom_)
+    {
+      bool found = true;
+
+      for (size_t i = 0; found && (i < bloomHashes); i++)
+      {
+        size_t bit = (h1 + i * h2) % total;
+        found = (bits[bit / 64] >> (bit % 64)) & 1;
+      }
+
+      if (found)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+}
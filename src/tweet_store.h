@@ -0,0 +1,81 @@
+#ifndef TWEET_STORE_H_C41F8E27
+#define TWEET_STORE_H_C41F8E27
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "tweet.h"
+
+namespace twitter {
+
+  // Holds the most recent tweets in a ring buffer, indexed by id, and
+  // evicts the oldest once either the count or the memory cap is reached.
+  // A bloom filter remembers ids for a while longer after their tweets have
+  // been evicted.
+  class tweet_store {
+  public:
+
+    // A memory cap of zero means only the count is capped. Memory is an
+    // estimate, which leaves out authors since those are shared.
+    explicit tweet_store(size_t capacity = 10000, size_t maxBytes = 0);
+
+    tweet_store(const tweet_store& other) = delete;
+    tweet_store& operator=(const tweet_store& other) = delete;
+
+    // Returns false, and keeps the stored instance, if a tweet with the same
+    // id is already held. Also returns false, without evicting anything, if
+    // the tweet alone is over the memory cap.
+    bool insert(tweet t);
+
+    // Returns nullptr if the tweet is not held.
+    std::shared_ptr<const tweet> find(tweet_id id) const;
+
+    bool contains(tweet_id id) const;
+
+    // Never returns false for an id inserted among roughly the last four
+    // capacities' worth of tweets, but may return true for an id that was
+    // never inserted.
+    bool mightHaveSeen(tweet_id id) const;
+
+    // Newest first; zero means all of them.
+    std::vector<std::shared_ptr<const tweet>> getRecent(size_t limit = 0) const;
+
+    size_t size() const;
+
+    size_t getMemoryUsage() const;
+
+    void clear();
+
+  private:
+
+    static size_t footprint(const tweet& t);
+
+    void evictOldest();
+
+    void remember(tweet_id id);
+
+    bool bloomContains(tweet_id id) const;
+
+    size_t capacity_;
+    size_t maxBytes_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<const tweet>> ring_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t bytes_ = 0;
+    std::unordered_map<tweet_id, std::shared_ptr<const tweet>> index_;
+
+    // Two generations of filter bits; once the current one has taken its
+    // share of ids it becomes the previous one, so that the filter forgets
+    // old ids instead of filling up.
+    std::vector<unsigned long long> bloom_[2];
+    size_t bloomCurrent_ = 0;
+    size_t bloomInserted_ = 0;
+    size_t bloomGeneration_;
+  };
+
+}
+
+#endif /* end of include guard: TWEET_STORE_H_C41F8E27 */
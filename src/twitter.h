@@ -15,5 +15,17 @@ namespace twitter {
 #include "tweet.h"
 #include "user.h"
 #include "configuration.h"
+#include "connection_pool.h"
+#include "engine.h"
+#include "user_table.h"
+#include "rate_limiter.h"
+#include "retry_policy.h"
+#include "id_set.h"
+#include "graph_sync.h"
+#include "signer.h"
+#include "client_pool.h"
+#include "timeline_scheduler.h"
+#include "checkpoint_store.h"
+#include "tweet_store.h"
 
 #endif /* end of include guard: TWITTER_H_AC7A7666 */
@@ -1,24 +1,83 @@
 #include "user.h"
 #include <json.hpp>
 #include "codes.h"
+#include "decoder.h"
 
 namespace twitter {
 
-  user::user(std::string data)
+  user::user(std::string data) try :
+    user(nlohmann::json::parse(data))
+  {
+  } catch (const std::invalid_argument& error)
+  {
+    std::throw_with_nested(malformed_object("user", data));
+  }
+
+  user::user(const nlohmann::json& data)
   {
     try
     {
-      auto json = nlohmann::json::parse(data);
-      _id = json["id"].get<user_id>();
-      _screen_name = json["screen_name"].get<std::string>();
-      _name = json["name"].get<std::string>();
-      _protected = json["protected"].get<bool>();
+      _id = data.at("id").get<user_id>();
+      _screen_name = data.at("screen_name").get<std::string>();
+      _name = data.at("name").get<std::string>();
+      _protected = data.at("protected").get<bool>();
+    } catch (const std::out_of_range& error)
+    {
+      std::throw_with_nested(malformed_object("user", data.dump()));
+    } catch (const std::domain_error& error)
+    {
+      std::throw_with_nested(malformed_object("user", data.dump()));
+    }
+  }
+
+  user::user(decoder& input)
+  {
+    try
+    {
+      bool hasId = false;
+      bool hasScreenName = false;
+      bool hasName = false;
+      bool hasProtected = false;
+
+      input.beginObject();
+
+      std::string key;
+      while (input.nextKey(key))
+      {
+        if (key == "id")
+        {
+          _id = input.readUnsigned();
+          hasId = true;
+        } else if (key == "screen_name")
+        {
+          _screen_name = input.readString();
+          hasScreenName = true;
+        } else if (key == "name")
+        {
+          _name = input.readString();
+          hasName = true;
+        } else if (key == "protected")
+        {
+          _protected = input.readBool();
+          hasProtected = true;
+        } else {
+          input.skipValue();
+        }
+      }
+
+      if (!hasId || !hasScreenName || !hasName || !hasProtected)
+      {
+        throw std::out_of_range("user is missing a required member");
+      }
+    } catch (const std::out_of_range& error)
+    {
+      std::throw_with_nested(malformed_object("user", input.getData()));
     } catch (const std::invalid_argument& error)
     {
-      std::throw_with_nested(malformed_object("user", data));
+      std::throw_with_nested(malformed_object("user", input.getData()));
     } catch (const std::domain_error& error)
     {
-      std::throw_with_nested(malformed_object("user", data));
+      std::throw_with_nested(malformed_object("user", input.getData()));
     }
   }
 
@@ -2,16 +2,29 @@
 #define USER_H_BF3AB38C
 
 #include <string>
+#include "../vendor/json/json.hpp"
 
 namespace twitter {
 
   typedef unsigned long long user_id;
 
+  class decoder;
+
   class user {
   public:
 
     user(std::string data);
 
+    explicit user(const nlohmann::json& data);
+
+    explicit user(decoder& input);
+
+    // A user known only by id, as in tweets fetched with trim_user when the
+    // user hasn't been seen in full yet.
+    explicit user(user_id id) : _id(id)
+    {
+    }
+
     user_id getID() const
     {
       return _id;
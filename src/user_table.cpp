@@ -0,0 +1,95 @@
+#include "user_table.h"
+#include <algorithm>
+
+namespace twitter {
+
+  user_table::user_table(size_t capacity) :
+    capacity_(std::max<size_t>(capacity, 1))
+  {
+  }
+
+  std::shared_ptr<const user> user_table::intern(user u)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(u.getID());
+    if (it != std::end(index_))
+    {
+      std::shared_ptr<const user>& stored = *it->second;
+
+      if ((stored->getScreenName() != u.getScreenName()) ||
+        (stored->getName() != u.getName()) ||
+        (stored->isProtected() != u.isProtected()))
+      {
+        stored = std::make_shared<const user>(std::move(u));
+      }
+
+      users_.splice(std::begin(users_), users_, it->second);
+
+      return users_.front();
+    }
+
+    users_.push_front(std::make_shared<const user>(std::move(u)));
+    index_.emplace(users_.front()->getID(), std::begin(users_));
+
+    evictLocked();
+
+    return users_.front();
+  }
+
+  std::shared_ptr<const user> user_table::find(user_id id) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(id);
+    if (it == std::end(index_))
+    {
+      return nullptr;
+    }
+
+    users_.splice(std::begin(users_), users_, it->second);
+
+    return users_.front();
+  }
+
+  size_t user_table::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return index_.size();
+  }
+
+  size_t user_table::getCapacity() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return capacity_;
+  }
+
+  void user_table::setCapacity(size_t capacity)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    capacity_ = std::max<size_t>(capacity, 1);
+
+    evictLocked();
+  }
+
+  void user_table::clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    index_.clear();
+    users_.clear();
+  }
+
+  void user_table::evictLocked()
+  {
+    while (index_.size() > capacity_)
+    {
+      index_.erase(users_.back()->getID());
+      users_.pop_back();
+    }
+  }
+
+}
@@ -0,0 +1,53 @@
+#ifndef USER_TABLE_H_5B93D0E1
+#define USER_TABLE_H_5B93D0E1
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "user.h"
+
+namespace twitter {
+
+  // Interns user objects by id so that tweets by the same author share one
+  // immutable instance, and remembers the users seen most recently. Once
+  // the table is full, the user least recently interned or found is
+  // forgotten; tweets that hold it keep it alive.
+  class user_table {
+  public:
+
+    explicit user_table(size_t capacity = 100000);
+
+    // Returns the stored instance for this user, replacing it first if the
+    // given one carries different profile data.
+    std::shared_ptr<const user> intern(user u);
+
+    // Returns nullptr if the user has not been seen or has been forgotten.
+    std::shared_ptr<const user> find(user_id id) const;
+
+    size_t size() const;
+
+    size_t getCapacity() const;
+
+    void setCapacity(size_t capacity);
+
+    void clear();
+
+  private:
+
+    using entry_list = std::list<std::shared_ptr<const user>>;
+
+    void evictLocked();
+
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+
+    // Most recently used first.
+    mutable entry_list users_;
+    std::unordered_map<user_id, entry_list::iterator> index_;
+  };
+
+}
+
+#endif /* end of include guard: USER_TABLE_H_5B93D0E1 */
@@ -1,4 +1,12 @@
 #include "util.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "codes.h"
 
 namespace twitter {
 
@@ -34,4 +42,124 @@ namespace twitter {
       return (result);
   }
 
+  static std::string describeError(const std::string& what)
+  {
+    return what + ": " + std::strerror(errno);
+  }
+
+  void writeFileAtomically(const std::string& path, const std::string& data)
+  {
+    // The temporary file gets a unique name, so that writers sharing a path
+    // can't write into each other's.
+    std::vector<char> temp(std::begin(path), std::end(path));
+    const std::string suffix = ".XXXXXX";
+    temp.insert(std::end(temp), std::begin(suffix), std::end(suffix));
+    temp.push_back('\0');
+
+    int fd = mkstemp(temp.data());
+    if (fd < 0)
+    {
+      throw storage_error(describeError("Could not create a file next to " + path));
+    }
+
+    const char* cur = data.data();
+    size_t left = data.size();
+
+    while (left > 0)
+    {
+      ssize_t written = write(fd, cur, left);
+
+      if (written < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        std::string message = describeError("Could not write " + path);
+        close(fd);
+        unlink(temp.data());
+
+        throw storage_error(message);
+      }
+
+      cur += written;
+      left -= written;
+    }
+
+    // Without this, a crash soon after the rename could leave the new name
+    // pointing at a file whose contents never reached the disk.
+    if (fsync(fd) != 0)
+    {
+      std::string message = describeError("Could not flush " + path);
+      close(fd);
+      unlink(temp.data());
+
+      throw storage_error(message);
+    }
+
+    if (close(fd) != 0)
+    {
+      std::string message = describeError("Could not write " + path);
+      unlink(temp.data());
+
+      throw storage_error(message);
+    }
+
+    if (std::rename(temp.data(), path.c_str()) != 0)
+    {
+      std::string message = describeError("Could not replace " + path);
+      unlink(temp.data());
+
+      throw storage_error(message);
+    }
+  }
+
+  bool readFile(const std::string& path, std::string& data)
+  {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      if (errno == ENOENT)
+      {
+        return false;
+      }
+
+      throw storage_error(describeError("Could not open " + path));
+    }
+
+    data.clear();
+
+    char buffer[64 * 1024];
+
+    for (;;)
+    {
+      ssize_t got = read(fd, buffer, sizeof(buffer));
+
+      if (got < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        std::string message = describeError("Could not read " + path);
+        close(fd);
+
+        throw storage_error(message);
+      }
+
+      if (got == 0)
+      {
+        break;
+      }
+
+      data.append(buffer, got);
+    }
+
+    close(fd);
+
+    return true;
+  }
+
 }
@@ -2,11 +2,22 @@
 #define UTIL_H_440DEAA0
 
 #include <ctime>
+#include <string>
 
 namespace twitter {
 
   time_t timegm(struct tm * t);
 
+  // Replaces the file's contents through a uniquely named temporary file,
+  // which is synced to disk before it is renamed over the file, so that a
+  // crash can't leave it truncated. Throws storage_error.
+  void writeFileAtomically(const std::string& path, const std::string& data);
+
+  // Returns false if the file doesn't exist. Throws storage_error if it
+  // can't be opened for any other reason, such as permissions, or can't be
+  // read.
+  bool readFile(const std::string& path, std::string& data);
+
 };
 
 #endif /* end of include guard: UTIL_H_440DEAA0 */